@@ -0,0 +1,88 @@
+#ifndef _LAMBDA_PERF_OVERLAY_H_
+#define _LAMBDA_PERF_OVERLAY_H_
+
+#include <SDL2/SDL.h>
+#include <string>
+#include <vector>
+
+/**
+ * @brief number of frames shown in the frame time graph
+ * */
+#define LE_PERF_OVERLAY_FRAMES 120
+
+/**
+ * @brief On-screen performance counters
+ *
+ * Shows FPS, frame times, draw calls, texture memory, object and group
+ * counts and events emitted per frame, over a graph of the last frame
+ * times. The text is rendered a few times per second and kept in
+ * textures, each frame only draws a few rectangles and textures straight
+ * to the window renderer, so the overlay doesn't show up in the counters.
+ *
+ * @see LE_Game::enablePerfOverlay
+ * */
+class LE_PerfOverlay {
+    private:
+        Uint32 windowId;
+        SDL_Scancode toggleKey;
+        bool visible;
+
+        /** @brief toggle key state on the last frame, to toggle on press */
+        bool keyDown;
+
+        /** @brief text lines, rendered by refresh */
+        std::vector<SDL_Texture*> lines;
+        std::vector<SDL_Rect> lineRects;
+
+        /** @brief frame times in milliseconds, a ring buffer */
+        float frameTimes[LE_PERF_OVERLAY_FRAMES];
+        int frameIndex;
+
+        Uint64 lastFrame;
+        Uint64 lastRefresh;
+        int framesSinceRefresh;
+        unsigned long long lastEmits;
+
+        /** @brief rectangles of the graph bars, kept to avoid allocations */
+        std::vector<SDL_Rect> bars[3];
+
+        /**
+         * @brief Render the text lines again with the current counters
+         * */
+        void refresh ();
+
+        void clearLines ();
+
+    public:
+        /**
+         * @brief Class constructor
+         *
+         * @param window window to draw the overlay into
+         * @param key key showing and hiding the overlay
+         * */
+        LE_PerfOverlay ( Uint32 window, SDL_Scancode key );
+
+        ~LE_PerfOverlay ();
+
+        /**
+         * @brief Measure the frame and handle the toggle key
+         *
+         * Called by LE_Game once per frame, before windows are redrawn
+         * */
+        void update ();
+
+        /**
+         * @brief Draw the overlay on top of the frame
+         *
+         * Called by LE_Game once the scene is drawn, before presenting
+         * */
+        void render ();
+
+        void setVisible ( bool state );
+
+        bool isVisible () { return visible; }
+
+        Uint32 getWindowId () { return windowId; }
+};
+
+#endif
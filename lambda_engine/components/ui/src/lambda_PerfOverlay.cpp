@@ -0,0 +1,156 @@
+#include "lambda_PerfOverlay.h"
+#include "lambda_Game.h"
+#include "lambda_FSM.h"
+#include "lambda_TextManager.h"
+#include "lambda_InputHandler.h"
+#include "lambda_events.h"
+#include <lambda_config.h>
+#include <algorithm>
+#include <cstdio>
+
+#define LE_PERF_OVERLAY_FONT "le_perf_overlay"
+
+/** @brief text refreshes per second */
+#define LE_PERF_OVERLAY_REFRESH 4
+
+/** @brief graph height in pixels, a bar this high is 2 frames at 60 Hz */
+#define LE_PERF_OVERLAY_GRAPH_H 66
+
+LE_PerfOverlay::LE_PerfOverlay ( Uint32 window, SDL_Scancode key ):
+    windowId(window), toggleKey(key), visible(true), keyDown(false),
+    frameIndex(0), lastRefresh(0), framesSinceRefresh(0) {
+    for ( int i = 0; i < LE_PERF_OVERLAY_FRAMES; i++ ) frameTimes[i] = 0;
+    lastFrame = SDL_GetPerformanceCounter();
+    lastEmits = LE_EVENTS->getEmitCount();
+
+    LE_TEXT->loadFont ( std::string(LE_ASSET_DIR) +
+            "/assets/fonts/Source_Code_Pro/static/SourceCodePro-Regular.ttf",
+            14, LE_PERF_OVERLAY_FONT );
+}
+
+LE_PerfOverlay::~LE_PerfOverlay () {
+    clearLines();
+    LE_TEXT->popFont ( LE_PERF_OVERLAY_FONT );
+    LE_TEXTURE->markDirty ( windowId );
+}
+
+void LE_PerfOverlay::clearLines () {
+    for ( SDL_Texture* line : lines ) {
+        if ( line != nullptr ) SDL_DestroyTexture ( line );
+    }
+    lines.clear();
+    lineRects.clear();
+}
+
+void LE_PerfOverlay::setVisible ( bool state ) {
+    visible = state;
+    // Force a refresh when shown, the text is stale
+    lastRefresh = 0;
+    LE_TEXTURE->markDirty ( windowId );
+}
+
+void LE_PerfOverlay::update () {
+    Uint64 now = SDL_GetPerformanceCounter();
+    Uint64 frequency = SDL_GetPerformanceFrequency();
+    frameTimes[frameIndex] = ( now - lastFrame ) * 1000.0 / frequency;
+    frameIndex = ( frameIndex + 1 ) % LE_PERF_OVERLAY_FRAMES;
+    lastFrame = now;
+    framesSinceRefresh++;
+
+    bool pressed = LE_INPUT->getKeyState ( toggleKey ) == keyState::pressed;
+    if ( pressed && !keyDown ) setVisible ( !visible );
+    keyDown = pressed;
+
+    if ( !visible ) return;
+
+    if ( now - lastRefresh >= frequency / LE_PERF_OVERLAY_REFRESH ) {
+        refresh();
+        lastRefresh = now;
+    }
+
+    // The graph moves every frame
+    LE_TEXTURE->markDirty ( windowId );
+}
+
+void LE_PerfOverlay::refresh () {
+    LE_FrameStats frames = LE_GAME->getFrameStats();
+    const LE_RenderStats& render = LE_TEXTURE->getRenderStats();
+
+    unsigned long long emits = LE_EVENTS->getEmitCount();
+    double emitsPerFrame = framesSinceRefresh > 0 ?
+        (double)( emits - lastEmits ) / framesSinceRefresh : 0;
+    lastEmits = emits;
+    framesSinceRefresh = 0;
+
+    int objects = 0, groups = 0;
+    LE_GameState* state = LE_FSM->getCurrentState();
+    if ( state != nullptr ) {
+        objects = state->getObjectCount();
+        groups = state->getGroupCount();
+    }
+
+    char text[5][96];
+    snprintf ( text[0], sizeof text[0], "FPS %.1f  avg %.2f ms  p99 %.2f ms",
+            frames.avg > 0 ? 1000.0 / frames.avg : 0.0, frames.avg, frames.p99 );
+    snprintf ( text[1], sizeof text[1], "jitter %.2f ms  max %.2f ms", frames.jitter, frames.max );
+    snprintf ( text[2], sizeof text[2], "draw calls %u  sprites %u  culled %u",
+            render.drawCalls, render.sprites, render.culled );
+    snprintf ( text[3], sizeof text[3], "textures %.1f MB  objects %d  groups %d",
+            LE_TEXTURE->getTextureMemory ( windowId ) / ( 1024.0 * 1024.0 ), objects, groups );
+    snprintf ( text[4], sizeof text[4], "events %.1f / frame", emitsPerFrame );
+
+    clearLines();
+    int y = 12;
+    for ( int i = 0; i < 5; i++ ) {
+        SDL_Rect rect = { 12, y, 0, 0 };
+        SDL_Texture* line = LE_TEXT->renderText ( text[i], windowId,
+                LE_PERF_OVERLAY_FONT, 255, 255, 255, 255, &rect.h, &rect.w );
+        lines.push_back ( line );
+        lineRects.push_back ( rect );
+        y += line != nullptr ? rect.h : 16;
+    }
+}
+
+void LE_PerfOverlay::render () {
+    if ( !visible ) return;
+
+    SDL_Renderer* renderer = LE_TEXTURE->getRenderer ( windowId );
+    if ( renderer == nullptr ) return;
+
+    // Draw over everything queued for the frame
+    LE_TEXTURE->flush ( windowId );
+
+    int width = 2 * LE_PERF_OVERLAY_FRAMES;
+    int textBottom = 12;
+    for ( const SDL_Rect& rect : lineRects ) {
+        width = std::max ( width, rect.w );
+        textBottom = rect.y + rect.h;
+    }
+    int graphTop = textBottom + 6;
+
+    SDL_Rect panel = { 6, 6, width + 12, graphTop + LE_PERF_OVERLAY_GRAPH_H };
+    SDL_SetRenderDrawBlendMode ( renderer, SDL_BLENDMODE_BLEND );
+    SDL_SetRenderDrawColor ( renderer, 0, 0, 0, 170 );
+    SDL_RenderFillRect ( renderer, &panel );
+
+    // Bars by color, green under a 60 Hz frame, yellow under two, red above
+    for ( int c = 0; c < 3; c++ ) bars[c].clear();
+    for ( int i = 0; i < LE_PERF_OVERLAY_FRAMES; i++ ) {
+        float ms = frameTimes[( frameIndex + i ) % LE_PERF_OVERLAY_FRAMES];
+        int h = std::min ( LE_PERF_OVERLAY_GRAPH_H, (int)( ms * 2 + 0.5f ) );
+        if ( h <= 0 ) continue;
+        int c = ms < 17.5f ? 0 : ms < 34.0f ? 1 : 2;
+        bars[c].push_back ( { 12 + 2 * i, graphTop + LE_PERF_OVERLAY_GRAPH_H - h, 2, h } );
+    }
+
+    const Uint8 colors[3][3] = { { 80, 220, 80 }, { 230, 200, 60 }, { 230, 70, 60 } };
+    for ( int c = 0; c < 3; c++ ) {
+        if ( bars[c].empty() ) continue;
+        SDL_SetRenderDrawColor ( renderer, colors[c][0], colors[c][1], colors[c][2], 255 );
+        SDL_RenderFillRects ( renderer, bars[c].data(), bars[c].size() );
+    }
+
+    for ( size_t i = 0; i < lines.size(); i++ ) {
+        if ( lines[i] != nullptr ) SDL_RenderCopy ( renderer, lines[i], NULL, &lineRects[i] );
+    }
+}
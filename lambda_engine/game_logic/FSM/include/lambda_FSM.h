@@ -1,11 +1,20 @@
 #ifndef _LAMBDA_ENGINE_FSM_H_
 #define _LAMBDA_ENGINE_FSM_H_
 
+    #include <atomic>
     #include <functional>
 #include <vector>
     #include <map>
+    #include <mutex>
     #include <string>
+    #include <typeindex>
+    #include <typeinfo>
+    #include <type_traits>
+    #include <unordered_map>
     #include "lambda_GameObject.h"
+    #include "lambda_SlotMap.h"
+    #include "lambda_ObjectPool.h"
+    #include "lambda_ECS.h"
     #include "lambda_group_base.h"
     #include <iostream>
 
@@ -28,11 +37,18 @@
      * */
     class LE_GameState
     {
+        friend class LE_StateMachine;
+
         protected:
             /**
-             * @brief map containing LE_GameObjects spawned into the state
+             * @brief LE_GameObjects spawned into the state, in spawn order
+             * */
+            LE_ObjectSlotMap gameObjects;
+
+            /**
+             * @brief handles of the objects added with a string id
              * */
-            std::map<std::string, LE_GameObject*> gameObjects;
+            std::unordered_map<std::string, LE_ObjectHandle> objectIds;
 
             /**
              * @brief map containing LE_Groups registered in this state
@@ -41,10 +57,10 @@
 
             typedef struct NewGameObject {
                 LE_GameObject* newObject;
-                std::string objID;
+                LE_ObjectHandle handle;
 
-                NewGameObject ( LE_GameObject* _newObject, std::string _objID ):
-                    newObject(_newObject), objID(_objID) {}
+                NewGameObject ( LE_GameObject* _newObject, LE_ObjectHandle _handle ):
+                    newObject(_newObject), handle(_handle) {}
             } NewGameObject;
 
             /**
@@ -55,13 +71,76 @@
             /**
              * @brief Queue of objects to be deleted on next lap
              * */
-            std::vector<std::string> objectDeleteQueue;
+            std::vector<LE_ObjectHandle> objectDeleteQueue;
+
+            /**
+             * @brief remove a deleted object from the id index
+             * */
+            void forgetObject ( LE_GameObject* obj );
+
+            /**
+             * @brief memory of the objects spawned from pools, released in clean
+             * */
+            LE_ObjectArena arena;
+
+            std::unordered_map<std::type_index, LE_ObjectPool*> pools;
+
+            /**
+             * @brief delete an object, giving its storage back to its pool
+             * if it was spawned
+             * */
+            void destroyObject ( LE_GameObject* obj );
+
+            template<typename T>
+            LE_ObjectPool* getPool () {
+                LE_ObjectPool*& pool = pools[std::type_index ( typeid(T) )];
+                if ( pool == nullptr )
+                    pool = new LE_ObjectPool ( &arena, typeid(T).name(), sizeof(T), alignof(T) );
+                return pool;
+            }
 
             /**
              * @brief Queue of groups to be deleted on next lap
              * */
             std::vector<std::string> groupDeleteQueue;
 
+            /**
+             * @brief objects drawn together into a cached layer
+             *
+             * @see LE_GameState::addCachedLayer
+             * */
+            typedef struct CachedLayer {
+                Uint32 windowId;
+                SDL_Rect area;
+                int layer;
+                int z;
+
+                /** @brief objects of the layer, collected on each render */
+                std::vector<LE_GameObject*> objects;
+            } CachedLayer;
+
+            std::map<std::string, CachedLayer> cachedLayers;
+
+            /**
+             * @brief entities of the state, created by getWorld
+             * */
+            LE_World* world;
+
+            /**
+             * @brief assets requested by on_preload, and the ones loaded
+             * */
+            std::atomic<int> preloadSteps;
+            std::atomic<int> preloadDone;
+
+            /**
+             * @brief how the states below are drawn
+             *
+             * @see LE_GameState::setOpaque
+             * @see LE_GameState::setFreezeBelow
+             * */
+            bool opaque;
+            bool freezeBelow;
+
         public:
 
             /**
@@ -87,13 +166,129 @@
              * */
             virtual void on_exit () { clean(); }
 
+            /**
+             * @brief executes the loading that doesn't need the main thread
+             *
+             * Called on a worker thread when the state is preloaded with
+             * LE_StateMachine::preload, while the current state keeps
+             * running; on_enter is called later as usual.
+             *
+             * Like the generator, it may:
+             * - parse files and build any data of the state
+             * - create objects, LE_Frame and LE_Sprite, since
+             *   LE_TextureManager::resolveTile is safe on any thread
+             * - load textures with preloadTextures and preloadTexture
+             *
+             * Any other use of SDL, LE_TEXTURE or the other engine managers,
+             * like creating tiles or loading tile maps, must be sent to
+             * preloadOnMainThread.
+             * */
+            virtual void on_preload () {}
+
+            /**
+             * @brief load textures and tiles from a xml file while preloading
+             *
+             * Images are decoded on workers, see
+             * LE_TextureManager::loadFromXmlFileAsync. The state is not
+             * pushed until they are loaded. Call it from on_preload.
+             *
+             * @param filePath path to xml file
+             * @param windowId
+             * */
+            void preloadTextures ( std::string filePath, Uint32 windowId );
+
+            /**
+             * @brief load a texture while preloading
+             *
+             * @see LE_TextureManager::loadTextureAsync
+             * */
+            void preloadTexture ( Uint32 windowId, std::string filePath, std::string textureId );
+
+            /**
+             * @brief run work on the main thread while preloading, like
+             * loading tile maps
+             *
+             * The state is not pushed until it has run.
+             * */
+            void preloadOnMainThread ( std::function<void()> work );
+
+            /**
+             * @brief fraction of the work requested by on_preload that is
+             * done, from 0 to 1
+             * */
+            float getPreloadProgress () {
+                int steps = preloadSteps.load();
+                return steps > 0 ? (float)preloadDone.load() / steps : 1;
+            }
+
             /**
              * @brief add a new game object into the state
              *
+             * The object is set up and starts updating on the next update.
+             * Objects are updated and drawn in the order they were added.
+             *
+             * Objects that don't need to be found by id can leave it
+             * empty, they get a unique one (used by groups and events) and
+             * skip the id index; keep the returned handle instead.
+             * Adding an object with the id of another one replaces it.
+             *
              * @param newObject object to be included
-             * @param objId Game Object ID
+             * @param objId Game Object ID, may be empty
+             * @return handle of the object, resolves once it is set up
+             * */
+            LE_ObjectHandle addObject ( LE_GameObject* newObject, std::string objId = "" );
+
+            /**
+             * @brief add many objects without ids at once
+             *
+             * Same as calling addObject for each one, making room for all
+             * of them once. Meant for mass spawning (particles, bullets...).
+             *
+             * @param newObjects objects to be included
+             * @param handles if not nullptr, gets the handle of each object
+             * */
+            void addObjects ( const std::vector<LE_GameObject*>& newObjects,
+                    std::vector<LE_ObjectHandle>* handles = nullptr );
+
+            /**
+             * @brief create an object in the memory of the state and add it
+             *
+             * Like addObject ( new T ( args... ) ), but the object is built
+             * in a pool of the state: destroyed objects give their memory
+             * back to the pool of their type for the next one, and the
+             * memory of every pool is freed at once when the state exits.
+             * Never delete spawned objects, pop them like any other.
+             *
+             * @param args arguments of the T constructor
+             * @return the object, its handle is obj->getHandle()
+             * */
+            template<typename T, typename... Args>
+            T* spawn ( Args&&... args ) {
+                static_assert ( std::is_base_of<LE_GameObject, T>::value,
+                        "spawn only creates LE_GameObjects" );
+                LE_ObjectPool* pool = getPool<T>();
+                T* obj = new ( pool->acquire() ) T ( std::forward<Args>(args)... );
+                obj->pool = pool;
+                addObject ( obj );
+                return obj;
+            }
+
+            /**
+             * @brief make room for count more objects of type T, so
+             * spawning them doesn't allocate
              * */
-            void addObject ( LE_GameObject* newObject, std::string objId );
+            template<typename T>
+            void reservePool ( size_t count ) { getPool<T>()->reserve ( count ); }
+
+            /**
+             * @brief live and recycled objects of every type spawned
+             * */
+            std::vector<LE_PoolStats> getPoolStats ();
+
+            /**
+             * @brief Bytes of memory taken by the pools of the state
+             * */
+            size_t getArenaSize () { return arena.getSize(); }
 
             /**
              * @brief deletes an object from the state
@@ -102,6 +297,13 @@
              * */
             void popObject ( std::string objId );
 
+            /**
+             * @brief deletes an object from the state
+             *
+             * @param handle handle returned by addObject
+             * */
+            void popObject ( LE_ObjectHandle handle );
+
             /**
              * @brief get object by it's ID
              *
@@ -110,6 +312,24 @@
              * */
             LE_GameObject* getObject ( std::string objId );
 
+            /**
+             * @brief get object by it's handle
+             *
+             * @param handle handle returned by addObject
+             * @return LE_GameObject*, nullptr once deleted
+             * */
+            LE_GameObject* getObject ( LE_ObjectHandle handle ) { return gameObjects.get ( handle ); }
+
+            /**
+             * @brief Number of game objects in the state
+             * */
+            int getObjectCount () { return gameObjects.size(); }
+
+            /**
+             * @brief Number of groups in the state
+             * */
+            int getGroupCount () { return groups.size(); }
+
             /**
              * @brief add a new game object into the state
              *
@@ -147,6 +367,116 @@
              * */
             void disableGroup ( std::string groupId );
 
+            /**
+             * @brief hide the states below this one
+             *
+             * States under an opaque state are not rendered, for states
+             * covering the whole window.
+             *
+             * @param state
+             * */
+            void setOpaque ( bool state ) { opaque = state; }
+
+            bool isOpaque () { return opaque; }
+
+            /**
+             * @brief draw the states below this one from a snapshot
+             *
+             * The states below, which don't update while this one is on
+             * top, are drawn once into a cached layer per window and camera,
+             * which is drawn every frame below this state instead of them,
+             * until this state is popped or the state stack changes. For
+             * pause menus and dialogs over the game.
+             *
+             * The snapshot is drawn again when a camera moves or the window
+             * is resized. Cached layers of the frozen states must not need
+             * redrawing while frozen, since cached layers can't be nested.
+             *
+             * @see LE_TextureManager::beginCachedLayer
+             *
+             * @param state
+             * */
+            void setFreezeBelow ( bool state ) { freezeBelow = state; }
+
+            bool isFreezingBelow () { return freezeBelow; }
+
+            /**
+             * @brief get the entity component system of the state
+             *
+             * Created on the first call. Entities live alongside the game
+             * objects of the state and are destroyed with them in clean.
+             * Update systems run after the state updates, render systems
+             * after it renders.
+             *
+             * @see LE_World
+             * */
+            LE_World* getWorld ();
+
+            /**
+             * @brief run the systems of a phase, if the state has a world
+             *
+             * Called by LE_StateMachine
+             * */
+            void runSystems ( LE_SystemPhase phase ) {
+                if ( world ) world->runSystems ( phase );
+            }
+
+            /**
+             * @brief Draw every object at its current position until the
+             * next update
+             *
+             * Called by LE_StateMachine when a state is pushed on top of
+             * this one, since states below the top one are drawn without
+             * being updated.
+             * */
+            void resetInterpolation () {
+                for ( LE_GameObject* obj : gameObjects.dense() )
+                    if ( obj ) obj->resetInterpolation();
+            }
+
+            /**
+             * @brief add a cached layer for static objects
+             *
+             * Objects with LE_GameObject::cacheLayer set to layerId are
+             * drawn together into a texture covering the area, which is
+             * drawn each frame instead of the objects, until one of them
+             * moves, changes frame, is added or removed. Cached layers are
+             * drawn before the other objects of the state.
+             *
+             * Cached layer ids are shared by every state drawing into the
+             * window.
+             *
+             * @see LE_TextureManager::beginCachedLayer
+             *
+             * @param layerId
+             * @param windowId window the objects are drawn into
+             * @param x area left position
+             * @param y area top position
+             * @param h area height
+             * @param w area width
+             * @param layer draw layer of the cached layer in the render queue
+             * @param z order inside the draw layer
+             * */
+            void addCachedLayer ( std::string layerId, Uint32 windowId,
+                    int x, int y, int h, int w, int layer = 0, int z = 0 );
+
+            /**
+             * @brief draw a cached layer again on the next frame
+             *
+             * Call it when objects of the layer change in ways the engine
+             * can't see, like a custom render
+             *
+             * @param layerId
+             * */
+            void invalidateCachedLayer ( std::string layerId );
+
+            /**
+             * @brief remove a cached layer, its objects are drawn every frame again
+             *
+             * @param layerId
+             * */
+            void popCachedLayer ( std::string layerId );
+
             /**
              * @brief get group by it's ID
              *
@@ -164,13 +494,24 @@
              * @brief deallocates all game Objects added to the state
              * */
             virtual void clean () {
-                for ( auto it = gameObjects.begin(); it != gameObjects.end(); it++ )
-                    delete it->second;
+                for ( LE_GameObject* obj : gameObjects.dense() )
+                    if ( obj ) destroyObject ( obj );
                 gameObjects.clear();
+                objectIds.clear();
                 for ( int i=0; i < objectQueue.size(); i++ ) {
-                    delete objectQueue[i].newObject;
+                    destroyObject ( objectQueue[i].newObject );
                 }
                 objectQueue.clear();
+                objectDeleteQueue.clear();
+                for ( auto it = pools.begin(); it != pools.end(); it++ )
+                    delete it->second;
+                pools.clear();
+                arena.release();
+                for ( auto it = cachedLayers.begin(); it != cachedLayers.end(); it++ )
+                    LE_TEXTURE->popCachedLayer ( it->second.windowId, it->first );
+                cachedLayers.clear();
+                delete world;
+                world = nullptr;
             }
     };
 
@@ -195,7 +536,65 @@
              * */
             LE_StateMachine ();
 
-            std::vector<LE_GameState*> changeQueue;
+            /**
+             * @brief state pushed or popped on the next update
+             * */
+            typedef struct StateChange {
+                /** @brief nullptr to pop */
+                LE_GameState* state;
+                /** @brief id of the preload to push once ready */
+                std::string preloadId;
+            } StateChange;
+
+            std::vector<StateChange> changeQueue;
+
+            /**
+             * @brief state being built on a worker thread
+             *
+             * Shared with the job under mutex: if the state machine is
+             * cleaned before the job ends, the job deletes both
+             * */
+            typedef struct Preload {
+                std::mutex mutex;
+                LE_GameState* state;
+                bool finished;
+                bool abandoned;
+            } Preload;
+
+            std::map<std::string, Preload*> preloads;
+
+            /**
+             * @brief returns the state preloaded for an id once everything
+             * it requested is loaded, nullptr otherwise
+             * */
+            LE_GameState* preloadedState ( const std::string& stateId );
+
+            /**
+             * @brief cached layer holding frozen states in a window
+             * */
+            typedef struct Snapshot {
+                Uint32 windowId;
+                std::string layerId;
+                SDL_Rect area;
+                bool build;
+            } Snapshot;
+
+            /** @brief snapshots drawn in the current camera pass */
+            std::vector<Snapshot> snapshotPass;
+
+            /** @brief cached layers created for snapshots */
+            std::vector<std::pair<Uint32, std::string>> snapshotLayers;
+
+            /**
+             * @brief Render states [begin, end) from their snapshot,
+             * drawing them into it first if needed
+             * */
+            void renderFrozen ( size_t begin, size_t end );
+
+            /**
+             * @brief Remove the snapshot cached layers
+             * */
+            void releaseSnapshots ();
 
             std::map<std::string, std::function<LE_GameState*()>> stateGenerators;
         public:
@@ -266,9 +665,45 @@
 
             /**
              * @brief adds a new LE_GameState to the state machine from a generator
+             *
+             * If the state is being preloaded, it is pushed once it is
+             * ready; the current state keeps running meanwhile, and the
+             * changes queued after it wait too.
              * */
             void push_back ( std::string stateId );
 
+            /**
+             * @brief build a state in the background before pushing it
+             *
+             * Runs the generator and LE_GameState::on_preload on a LE_JOBS
+             * worker, then waits for the assets requested by on_preload.
+             * Both are limited to what LE_GameState::on_preload allows.
+             * Push it with push_back ( stateId ) at any time.
+             *
+             * @code
+             * LE_FSM->preload ( "level2" );
+             * // on the following frames
+             * drawLoadingBar ( LE_FSM->getPreloadProgress ( "level2" ) );
+             * if ( LE_FSM->isPreloaded ( "level2" ) ) LE_FSM->push_back ( "level2" );
+             * @endcode
+             *
+             * @param stateId id of the generator
+             * */
+            void preload ( std::string stateId );
+
+            /**
+             * @brief progress of a preload, from 0 to 1
+             *
+             * 0 while on_preload runs or if the state isn't being preloaded
+             * */
+            float getPreloadProgress ( std::string stateId );
+
+            /**
+             * @brief returns true once a preloaded state can be pushed
+             * without waiting
+             * */
+            bool isPreloaded ( std::string stateId ) { return preloadedState ( stateId ) != nullptr; }
+
             /**
              * @brief deletes statePool back and deallocates that game state
              * */
@@ -281,6 +716,9 @@
 
             /**
              * @brief renders all states in the State Pool
+             *
+             * Stops at opaque states, and draws the states below a state
+             * freezing them from a snapshot.
              * */
             void render ();
 
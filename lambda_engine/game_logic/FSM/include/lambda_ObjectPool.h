@@ -0,0 +1,110 @@
+#ifndef _LAMBDA_ENGINE_OBJECT_POOL_H_
+#define _LAMBDA_ENGINE_OBJECT_POOL_H_
+
+    #include <cstddef>
+    #include <string>
+    #include <vector>
+
+    /**
+     * @brief Memory of a LE_GameState, handed out in chunks
+     *
+     * Allocations only move a pointer forward; memory is never given
+     * back one allocation at a time, only all at once by release.
+     * */
+    class LE_ObjectArena
+    {
+        private:
+            std::vector<char*> chunks;
+
+            /** @brief bytes used of the last chunk */
+            size_t used;
+            size_t chunkSize;
+            size_t lastChunkSize;
+            size_t total;
+
+        public:
+            /**
+             * @param size bytes of each chunk, allocations larger than it
+             * get their own
+             * */
+            LE_ObjectArena ( size_t size = 65536 ):
+                used(0), chunkSize(size), lastChunkSize(0), total(0) {}
+
+            ~LE_ObjectArena () { release(); }
+
+            /**
+             * @brief Get memory for size bytes aligned to align
+             * */
+            void* allocate ( size_t size, size_t align );
+
+            /**
+             * @brief Free every chunk, nothing allocated may be in use
+             * */
+            void release ();
+
+            /**
+             * @brief Bytes taken from the system
+             * */
+            size_t getSize () { return total; }
+    };
+
+    /**
+     * @brief Live and recycled objects of a type
+     *
+     * @see LE_GameState::getPoolStats
+     * */
+    typedef struct LE_PoolStats {
+        std::string type;
+        size_t blockSize;
+        size_t live;
+        size_t pooled;
+    } LE_PoolStats;
+
+    /**
+     * @brief Storage for the objects of one type
+     *
+     * Blocks come from the arena of the state and are kept on a free list
+     * when their object is destroyed, to be reused by the next one.
+     *
+     * @see LE_GameState::spawn
+     * */
+    class LE_ObjectPool
+    {
+        private:
+            LE_ObjectArena* arena;
+
+            size_t blockSize;
+            size_t blockAlign;
+
+            std::vector<void*> freeBlocks;
+
+        public:
+            std::string type;
+            size_t live;
+
+            LE_ObjectPool ( LE_ObjectArena* objectArena, std::string typeName,
+                    size_t size, size_t align ):
+                arena(objectArena), blockSize(size), blockAlign(align),
+                type(typeName), live(0) {}
+
+            /**
+             * @brief Get a block for a new object
+             * */
+            void* acquire ();
+
+            /**
+             * @brief Give back the block of a destroyed object
+             * */
+            void release ( void* block );
+
+            /**
+             * @brief Allocate count more free blocks ahead of spawning
+             * */
+            void reserve ( size_t count );
+
+            LE_PoolStats getStats () {
+                return { type, blockSize, live, freeBlocks.size() };
+            }
+    };
+
+#endif
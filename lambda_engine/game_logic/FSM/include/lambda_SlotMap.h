@@ -0,0 +1,150 @@
+#ifndef _LAMBDA_ENGINE_SLOT_MAP_H_
+#define _LAMBDA_ENGINE_SLOT_MAP_H_
+
+    #include <SDL2/SDL.h>
+    #include <vector>
+
+    class LE_GameObject;
+
+    /**
+     * @brief Stable reference to a game object of a LE_GameState
+     *
+     * Handles stay valid while the object lives and never point to another
+     * object once it is deleted, even if its slot is reused: the slot
+     * generation changes and the old handle resolves to nullptr.
+     *
+     * @see LE_GameState::addObject
+     * */
+    typedef struct LE_ObjectHandle {
+        Uint32 index;
+        Uint32 generation;
+
+        LE_ObjectHandle (): index(0xFFFFFFFF), generation(0) {}
+
+        LE_ObjectHandle ( Uint32 _index, Uint32 _generation ):
+            index(_index), generation(_generation) {}
+
+        /**
+         * @brief returns false for handles that never pointed to an object
+         * */
+        bool valid () const { return index != 0xFFFFFFFF; }
+
+        bool operator== ( const LE_ObjectHandle& other ) const {
+            return index == other.index && generation == other.generation;
+        }
+
+        bool operator!= ( const LE_ObjectHandle& other ) const {
+            return !( *this == other );
+        }
+    } LE_ObjectHandle;
+
+    /**
+     * @brief Value used for handles that do not point to any object
+     * */
+    #define LE_INVALID_OBJECT_HANDLE LE_ObjectHandle()
+
+    /**
+     * @brief Generational slot map storing the game objects of a state
+     *
+     * Objects are kept in a dense vector in the order they were placed,
+     * iterated without indirections. Handles index a slot, which knows
+     * where its object is in the dense vector.
+     *
+     * Erasing leaves a hole in the dense vector until LE_ObjectSlotMap::compact
+     * is called, so objects can be erased while iterating, and the order of
+     * the others is kept.
+     * */
+    class LE_ObjectSlotMap
+    {
+        private:
+            /**
+             * @brief dense value of slots holding no object yet
+             * */
+            static const Uint32 PENDING = 0xFFFFFFFE;
+
+            /**
+             * @brief dense value of unused slots
+             * */
+            static const Uint32 FREE = 0xFFFFFFFF;
+
+            typedef struct Slot {
+                /** @brief position of the object in objects, PENDING or FREE */
+                Uint32 dense;
+                Uint32 generation;
+                /** @brief next unused slot while FREE */
+                Uint32 nextFree;
+            } Slot;
+
+            std::vector<Slot> slots;
+            Uint32 firstFree;
+
+            /** @brief objects in placement order, nullptr for erased ones */
+            std::vector<LE_GameObject*> objects;
+            /** @brief slot of each object */
+            std::vector<Uint32> owners;
+
+            /** @brief erased objects waiting for compact */
+            size_t holes;
+
+            Slot* slot ( LE_ObjectHandle handle );
+
+        public:
+            LE_ObjectSlotMap (): firstFree(FREE), holes(0) {}
+
+            /**
+             * @brief Take a slot for an object placed later
+             *
+             * The handle resolves to nullptr until LE_ObjectSlotMap::place
+             * */
+            LE_ObjectHandle reserve ();
+
+            /**
+             * @brief Store the object of a reserved slot at the end of the
+             * dense vector
+             *
+             * @return false if the slot was erased meanwhile
+             * */
+            bool place ( LE_ObjectHandle handle, LE_GameObject* object );
+
+            /**
+             * @brief get the object of a handle
+             *
+             * @return nullptr if it was erased, or isn't placed yet
+             * */
+            LE_GameObject* get ( LE_ObjectHandle handle );
+
+            /**
+             * @brief Free the slot of a handle, its object is not deleted
+             *
+             * @return the object that was stored, nullptr if none
+             * */
+            LE_GameObject* erase ( LE_ObjectHandle handle );
+
+            /**
+             * @brief Remove the holes left by erase, keeping the order
+             * */
+            void compact ();
+
+            /**
+             * @brief Make room for more objects, before spawning many
+             * */
+            void reserveCapacity ( size_t count );
+
+            /**
+             * @brief Free every slot, objects are not deleted
+             * */
+            void clear ();
+
+            /**
+             * @brief Number of objects stored
+             * */
+            size_t size () { return objects.size() - holes; }
+
+            /**
+             * @brief objects in placement order, may hold nullptr between
+             * erase and compact
+             * */
+            const std::vector<LE_GameObject*>& dense () { return objects; }
+    };
+
+#endif
@@ -1,27 +1,127 @@
 #include "lambda_FSM.h"
+#include "lambda_Game.h"
+#include "lambda_Profiler.h"
+#include <algorithm>
+#include <limits>
 
 LE_StateMachine* LE_StateMachine::the_instance;
 
 
-LE_GameState::LE_GameState () {}
+LE_GameState::LE_GameState (): world(nullptr), preloadSteps(0), preloadDone(0),
+    opaque(false), freezeBelow(false) {}
 
-void LE_GameState::addObject ( LE_GameObject* newObject, std::string objId ) {
-    newObject->id = objId;
-    objectQueue.push_back( { newObject, objId } );
+LE_World* LE_GameState::getWorld () {
+    if ( world == nullptr ) world = new LE_World();
+    return world;
+}
+
+LE_ObjectHandle LE_GameState::addObject ( LE_GameObject* newObject, std::string objId ) {
+    LE_ObjectHandle handle = gameObjects.reserve();
+    newObject->handle = handle;
+
+    if ( objId.empty() ) {
+        newObject->id = "#" + std::to_string ( handle.index ) + ":" +
+            std::to_string ( handle.generation );
+    } else {
+        newObject->id = objId;
+        auto it = objectIds.find ( objId );
+        if ( it != objectIds.end() ) {
+            objectDeleteQueue.push_back ( it->second );
+            it->second = handle;
+        } else {
+            objectIds.emplace ( objId, handle );
+        }
+    }
+
+    objectQueue.push_back( { newObject, handle } );
+    return handle;
+}
+
+void LE_GameState::addObjects ( const std::vector<LE_GameObject*>& newObjects,
+        std::vector<LE_ObjectHandle>* handles ) {
+    objectQueue.reserve ( objectQueue.size() + newObjects.size() );
+    if ( handles ) handles->reserve ( handles->size() + newObjects.size() );
+
+    for ( LE_GameObject* obj : newObjects ) {
+        LE_ObjectHandle handle = addObject ( obj );
+        if ( handles ) handles->push_back ( handle );
+    }
 }
 
 void LE_GameState::popObject ( std::string objId ) {
-    objectDeleteQueue.push_back( objId );
+    auto it = objectIds.find ( objId );
+    if ( it != objectIds.end() ) {
+        objectDeleteQueue.push_back( it->second );
+    }
+}
+
+void LE_GameState::popObject ( LE_ObjectHandle handle ) {
+    objectDeleteQueue.push_back( handle );
+}
+
+void LE_GameState::destroyObject ( LE_GameObject* obj ) {
+    LE_ObjectPool* pool = obj->pool;
+    if ( pool == nullptr ) {
+        delete obj;
+        return;
+    }
+    // The block starts at the most derived object
+    void* block = dynamic_cast<void*> ( obj );
+    obj->~LE_GameObject();
+    pool->release ( block );
+}
+
+std::vector<LE_PoolStats> LE_GameState::getPoolStats () {
+    std::vector<LE_PoolStats> stats;
+    for ( auto it = pools.begin(); it != pools.end(); it++ )
+        stats.push_back ( it->second->getStats() );
+    return stats;
 }
 
 LE_GameObject* LE_GameState::getObject ( std::string objId ) {
-    auto it = gameObjects.find(objId);
-    if (it != gameObjects.end()) {
-        return it->second;
+    auto it = objectIds.find(objId);
+    if (it != objectIds.end()) {
+        return gameObjects.get ( it->second );
     }
     return nullptr;
 }
 
+void LE_GameState::forgetObject ( LE_GameObject* obj ) {
+    if ( objectIds.empty() ) return;
+    auto it = objectIds.find ( obj->id );
+    if ( it != objectIds.end() && it->second == obj->handle ) {
+        objectIds.erase ( it );
+    }
+}
+
+void LE_GameState::preloadTextures ( std::string filePath, Uint32 windowId ) {
+    preloadSteps++;
+    LE_JOBS->runOnMainThread ( [this, filePath, windowId]() {
+        LE_TEXTURE->loadFromXmlFileAsync ( filePath, windowId, [this, filePath]( bool loaded ) {
+            if ( !loaded ) std::cerr << "Error preloading " << filePath << std::endl;
+            preloadDone++;
+        } );
+    } );
+}
+
+void LE_GameState::preloadTexture ( Uint32 windowId, std::string filePath, std::string textureId ) {
+    preloadSteps++;
+    LE_JOBS->runOnMainThread ( [this, windowId, filePath, textureId]() {
+        LE_TEXTURE->loadTextureAsync ( windowId, filePath, textureId, [this, filePath]( bool loaded ) {
+            if ( !loaded ) std::cerr << "Error preloading " << filePath << std::endl;
+            preloadDone++;
+        } );
+    } );
+}
+
+void LE_GameState::preloadOnMainThread ( std::function<void()> work ) {
+    preloadSteps++;
+    LE_JOBS->runOnMainThread ( [this, work]() {
+        work();
+        preloadDone++;
+    } );
+}
+
 void LE_GameState::addGroup ( LE_Group* newGroup, std::string groupId ) {
     newGroup->id = groupId;
     groups[groupId] = newGroup;
@@ -54,26 +154,41 @@ void LE_GameState::disableGroup ( std::string groupId ) {
 }
 
 inline void LE_GameState::update () {
+    LE_PROFILE_SCOPE ( "LE_GameState::update" );
+    bool dirtyTracking = LE_TEXTURE->isDirtyTracking();
 
-    // Create new Objects
-    if (objectQueue.size() > 0) {
-        for (int i = 0; i < objectQueue.size(); i++) {
-            gameObjects[objectQueue[i].objID] = objectQueue[i].newObject;
-            objectQueue[i].newObject->setup();
-        }
-        objectQueue.clear();
-    }
-
-    // Delete objects
+    // Delete objects, the ones still queued for creation are dropped then
     if (objectDeleteQueue.size() > 0) {
         for (int i = 0; i < objectDeleteQueue.size(); i++) {
-            auto it = gameObjects.find ( objectDeleteQueue[i] );
-            if ( it != gameObjects.end() ) {
-                delete it->second;
-                gameObjects.erase(it);
+            LE_GameObject* obj = gameObjects.erase ( objectDeleteQueue[i] );
+            if ( obj ) {
+                if ( dirtyTracking ) obj->markDirty();
+                if ( !obj->cacheLayer.empty() )
+                    invalidateCachedLayer ( obj->cacheLayer );
+                forgetObject ( obj );
+                destroyObject ( obj );
             }
         }
         objectDeleteQueue.clear();
+        gameObjects.compact();
+    }
+
+    // Create new Objects
+    if (objectQueue.size() > 0) {
+        gameObjects.reserveCapacity ( objectQueue.size() );
+        // setup may add more objects, which are created too
+        for (int i = 0; i < objectQueue.size(); i++) {
+            LE_GameObject* obj = objectQueue[i].newObject;
+            if ( !gameObjects.place ( objectQueue[i].handle, obj ) ) {
+                forgetObject ( obj );
+                destroyObject ( obj );
+                continue;
+            }
+            obj->setup();
+            if ( dirtyTracking ) obj->markDirty();
+            if ( !obj->cacheLayer.empty() ) invalidateCachedLayer ( obj->cacheLayer );
+        }
+        objectQueue.clear();
     }
 
     // Delete groups
@@ -88,39 +203,120 @@ inline void LE_GameState::update () {
         groupDeleteQueue.clear();
     }
 
+    // Keep the position before this update to draw between updates
+    if ( LE_GAME->isTimestepFixed() ) {
+        for ( LE_GameObject* obj : gameObjects.dense() ) {
+            obj->storePrevious();
+        }
+    }
+
     // Groups update
     for (auto it = groups.begin(); it != groups.end(); it++) {
         LE_Group* gr = it->second;
-        if (gr->isEnabled()) gr->update();
+        if (!gr->isEnabled()) continue;
+
+        if ( gr->profileName == nullptr && LE_PROFILER->isEnabled() ) {
+            gr->profileName = LE_PROFILER->intern ( "group " + it->first );
+        }
+        LE_PROFILE_SCOPE ( gr->profileName != nullptr ? gr->profileName : "group" );
+        gr->update();
     }
 
-    // A state must have at least one object to update
+    // A state must have at least one object or entity to update
     if ( gameObjects.size() < 1 ) {
-        std::cerr << "State with no game objects to update" << std::endl;
+        if ( world == nullptr )
+            std::cerr << "State with no game objects to update" << std::endl;
         return;
     }
     // Update objects or delete the ones with destroy_me property
-    for ( auto it = gameObjects.begin(); it != gameObjects.end(); ) {
-        if ( it->second->destroy_me ) {
-            delete it->second;
-            it = gameObjects.erase (it);
+    const std::vector<LE_GameObject*>& objects = gameObjects.dense();
+    for ( size_t i = 0; i < objects.size(); i++ ) {
+        LE_GameObject* obj = objects[i];
+        if ( obj->destroy_me ) {
+            if ( dirtyTracking ) obj->markDirty();
+            if ( !obj->cacheLayer.empty() ) invalidateCachedLayer ( obj->cacheLayer );
+            gameObjects.erase ( obj->handle );
+            forgetObject ( obj );
+            destroyObject ( obj );
         } else {
-            it->second->update();
-            it++;
+            obj->update();
+            bool cached = !obj->cacheLayer.empty();
+            if ( ( dirtyTracking || cached ) && obj->checkDrawState() && cached )
+                invalidateCachedLayer ( obj->cacheLayer );
         }
     }
+    gameObjects.compact();
 }
 
 void LE_GameState::render () {
     if ( gameObjects.size() < 1 ) {
-        std::cerr << "State with no game objects to render" << std::endl;
+        if ( world == nullptr )
+            std::cerr << "State with no game objects to render" << std::endl;
         return;
     }
-    for ( auto it = gameObjects.begin(); it != gameObjects.end(); ++it ) {
-        it->second->render();
+
+    if ( cachedLayers.empty() ) {
+        for ( LE_GameObject* obj : gameObjects.dense() ) {
+            obj->render();
+        }
+        return;
+    }
+
+    // Objects of cached layers are only drawn when their layer is drawn again
+    for ( auto it = cachedLayers.begin(); it != cachedLayers.end(); it++ )
+        it->second.objects.clear();
+
+    for ( LE_GameObject* obj : gameObjects.dense() ) {
+        if ( obj->cacheLayer.empty() ) continue;
+        auto layer = cachedLayers.find ( obj->cacheLayer );
+        if ( layer != cachedLayers.end() ) layer->second.objects.push_back ( obj );
+    }
+
+    LE_TextureManager* tm = LE_TEXTURE;
+    for ( auto it = cachedLayers.begin(); it != cachedLayers.end(); it++ ) {
+        CachedLayer& cached = it->second;
+        if ( tm->beginCachedLayer ( cached.windowId, it->first,
+                    cached.area.x, cached.area.y, cached.area.h, cached.area.w ) ) {
+            for ( LE_GameObject* obj : cached.objects ) obj->render();
+        }
+        tm->endCachedLayer ( cached.windowId, it->first, cached.layer, cached.z );
+    }
+
+    for ( LE_GameObject* obj : gameObjects.dense() ) {
+        const std::string& layerId = obj->cacheLayer;
+        if ( !layerId.empty() && cachedLayers.count ( layerId ) ) continue;
+        obj->render();
     }
 }
 
+void LE_GameState::addCachedLayer ( std::string layerId, Uint32 windowId,
+        int x, int y, int h, int w, int layer, int z ) {
+    auto it = cachedLayers.find ( layerId );
+    if ( it != cachedLayers.end() && it->second.windowId != windowId )
+        LE_TEXTURE->popCachedLayer ( it->second.windowId, layerId );
+
+    CachedLayer& cached = cachedLayers[layerId];
+    cached.windowId = windowId;
+    cached.area = { x, y, w, h };
+    cached.layer = layer;
+    cached.z = z;
+    LE_TEXTURE->invalidateCachedLayer ( windowId, layerId );
+}
+
+void LE_GameState::invalidateCachedLayer ( std::string layerId ) {
+    auto it = cachedLayers.find ( layerId );
+    if ( it != cachedLayers.end() )
+        LE_TEXTURE->invalidateCachedLayer ( it->second.windowId, layerId );
+}
+
+void LE_GameState::popCachedLayer ( std::string layerId ) {
+    auto it = cachedLayers.find ( layerId );
+    if ( it == cachedLayers.end() ) return;
+
+    LE_TEXTURE->popCachedLayer ( it->second.windowId, layerId );
+    cachedLayers.erase ( it );
+}
+
 
 LE_StateMachine::LE_StateMachine () {};
 
@@ -160,10 +356,16 @@ void LE_StateMachine::popGenerator ( std::string stateId ) {
 }
 
 void LE_StateMachine::push_back ( LE_GameState* newState ) {
-    changeQueue.push_back( newState );
+    changeQueue.push_back( { newState, "" } );
 }
 
 void LE_StateMachine::push_back ( std::string stateId ) {
+    // Preloaded states are pushed by update once they are ready
+    if ( preloads.count ( stateId ) ) {
+        changeQueue.push_back( { nullptr, stateId } );
+        return;
+    }
+
     auto it = stateGenerators.find ( stateId );
     if ( it == stateGenerators.end() ) {
         std::cout << "Error pushing state " << stateId <<
@@ -175,24 +377,104 @@ void LE_StateMachine::push_back ( std::string stateId ) {
 }
 
 void LE_StateMachine::pop_back () {
-    changeQueue.push_back( nullptr );
+    changeQueue.push_back( { nullptr, "" } );
+}
+
+void LE_StateMachine::preload ( std::string stateId ) {
+    auto it = stateGenerators.find ( stateId );
+    if ( it == stateGenerators.end() ) {
+        std::cout << "Error preloading state " << stateId <<
+            ": generator not found";
+        return;
+    }
+    if ( preloads.count ( stateId ) ) {
+        std::cout << stateId << " is already being preloaded";
+        return;
+    }
+
+    Preload* p = new Preload();
+    p->state = nullptr;
+    p->finished = false;
+    p->abandoned = false;
+    preloads[stateId] = p;
+
+    std::function<LE_GameState*()> generator = it->second;
+    LE_JOBS->run ( [p, generator]() {
+        LE_GameState* state;
+        {
+            LE_PROFILE_SCOPE ( "preload state" );
+            state = generator();
+            state->on_preload();
+        }
+
+        std::unique_lock<std::mutex> lock ( p->mutex );
+        if ( p->abandoned ) {
+            lock.unlock();
+            delete p;
+            // Objects of the state may use the managers when deleted
+            LE_JOBS->runOnMainThread ( [state]() { delete state; } );
+            return;
+        }
+        p->state = state;
+        p->finished = true;
+    } );
+}
+
+LE_GameState* LE_StateMachine::preloadedState ( const std::string& stateId ) {
+    auto it = preloads.find ( stateId );
+    if ( it == preloads.end() ) return nullptr;
+
+    LE_GameState* state;
+    {
+        std::lock_guard<std::mutex> lock ( it->second->mutex );
+        if ( !it->second->finished ) return nullptr;
+        state = it->second->state;
+    }
+    if ( state->preloadDone.load() < state->preloadSteps.load() ) return nullptr;
+    return state;
+}
+
+float LE_StateMachine::getPreloadProgress ( std::string stateId ) {
+    auto it = preloads.find ( stateId );
+    if ( it == preloads.end() ) return 0;
+
+    std::lock_guard<std::mutex> lock ( it->second->mutex );
+    return it->second->finished ? it->second->state->getPreloadProgress() : 0;
 }
 
 void LE_StateMachine::update () {
 
     // Check for state changes
     if (changeQueue.size() > 0) {
-        for (int i = 0; i < changeQueue.size(); i++) {
-            if ( changeQueue[i] == nullptr ) {
+        size_t applied = 0;
+        for (; applied < changeQueue.size(); applied++) {
+            // Copied, on_enter may queue more changes
+            StateChange change = changeQueue[applied];
+
+            // Keep running the current state until the preload is ready
+            if ( !change.preloadId.empty() ) {
+                change.state = preloadedState ( change.preloadId );
+                if ( change.state == nullptr ) break;
+                delete preloads[change.preloadId];
+                preloads.erase ( change.preloadId );
+            }
+
+            if ( change.state == nullptr ) {
                 statePool.back()->on_exit();
                 delete statePool.back();
                 statePool.pop_back();
             } else {
-                statePool.push_back ( changeQueue[i] );
-                changeQueue[i]->on_enter();
+                // Paused states must not keep sliding between their last positions
+                if ( !statePool.empty() ) statePool.back()->resetInterpolation();
+                statePool.push_back ( change.state );
+                change.state->on_enter();
             }
         }
-        changeQueue.clear();
+        if ( applied > 0 ) {
+            changeQueue.erase ( changeQueue.begin(), changeQueue.begin() + applied );
+            releaseSnapshots();
+            LE_TEXTURE->markAllDirty();
+        }
     }
 
     // Only updates the current state
@@ -201,6 +483,7 @@ void LE_StateMachine::update () {
         return;
     }
     statePool.back()->update();
+    statePool.back()->runSystems ( LE_SystemPhase::update );
 
 }
 
@@ -210,16 +493,95 @@ void LE_StateMachine::render () {
         std::cerr << "No states to render" << std::endl;
         return;
     }
-    for (auto state : statePool) {
-        state->render();
+
+    // Lowest state drawn as usual, states below it are hidden or frozen
+    size_t first = statePool.size() - 1;
+    while ( first > 0 && !statePool[first]->opaque && !statePool[first]->freezeBelow ) first--;
+
+    if ( first > 0 && !statePool[first]->opaque ) {
+        size_t bottom = first - 1;
+        while ( bottom > 0 && !statePool[bottom]->opaque ) bottom--;
+        renderFrozen ( bottom, first );
+    } else if ( !snapshotLayers.empty() ) {
+        releaseSnapshots();
+    }
+
+    for ( size_t i = first; i < statePool.size(); i++ ) {
+        statePool[i]->render();
+        statePool[i]->runSystems ( LE_SystemPhase::render );
+    }
+}
+
+void LE_StateMachine::renderFrozen ( size_t begin, size_t end ) {
+    LE_PROFILE_SCOPE ( "frozen states" );
+    LE_TextureManager* tm = LE_TEXTURE;
+
+    snapshotPass.clear();
+    bool build = false;
+    for ( Uint32 windowId : LE_GAME->getRedrawWindows() ) {
+        Snapshot snapshot;
+        LE_Camera* camera;
+        if ( !tm->getPassView ( windowId, &snapshot.area, &camera ) ) continue;
+
+        snapshot.windowId = windowId;
+        snapshot.layerId = camera ? "le_frozen_states_" + camera->getId() : "le_frozen_states";
+        snapshot.build = tm->beginCachedLayer ( windowId, snapshot.layerId,
+                snapshot.area.x, snapshot.area.y, snapshot.area.h, snapshot.area.w );
+        build = build || snapshot.build;
+        snapshotPass.push_back ( snapshot );
+
+        std::pair<Uint32, std::string> key ( windowId, snapshot.layerId );
+        if ( std::find ( snapshotLayers.begin(), snapshotLayers.end(), key ) == snapshotLayers.end() )
+            snapshotLayers.push_back ( key );
+    }
+
+    if ( build ) {
+        // States draw into every window at once, so every snapshot is drawn again
+        for ( Snapshot& snapshot : snapshotPass ) {
+            if ( snapshot.build ) continue;
+            tm->invalidateCachedLayer ( snapshot.windowId, snapshot.layerId );
+            tm->beginCachedLayer ( snapshot.windowId, snapshot.layerId,
+                    snapshot.area.x, snapshot.area.y, snapshot.area.h, snapshot.area.w );
+        }
+        for ( size_t i = begin; i < end; i++ ) {
+            statePool[i]->render();
+            statePool[i]->runSystems ( LE_SystemPhase::render );
+        }
+    }
+
+    // Below everything the states above draw
+    for ( Snapshot& snapshot : snapshotPass ) {
+        tm->endCachedLayer ( snapshot.windowId, snapshot.layerId,
+                std::numeric_limits<int>::min(), std::numeric_limits<int>::min() );
     }
 }
 
+void LE_StateMachine::releaseSnapshots () {
+    for ( auto& layer : snapshotLayers )
+        LE_TEXTURE->popCachedLayer ( layer.first, layer.second );
+    snapshotLayers.clear();
+}
+
 void LE_StateMachine::clean () {
+    releaseSnapshots();
     for (auto state : statePool) {
         delete state;
     }
     statePool.clear();
     changeQueue.clear();
     stateGenerators.clear();
+
+    // Jobs still building a state delete it themselves when they end
+    for ( auto it = preloads.begin(); it != preloads.end(); it++ ) {
+        Preload* p = it->second;
+        std::unique_lock<std::mutex> lock ( p->mutex );
+        if ( p->finished ) {
+            lock.unlock();
+            delete p->state;
+            delete p;
+        } else {
+            p->abandoned = true;
+        }
+    }
+    preloads.clear();
 }
@@ -0,0 +1,56 @@
+#include "lambda_ObjectPool.h"
+#include <cstdint>
+#include <new>
+
+void* LE_ObjectArena::allocate ( size_t size, size_t align ) {
+    if ( !chunks.empty() ) {
+        uintptr_t base = (uintptr_t)chunks.back();
+        uintptr_t start = ( base + used + align - 1 ) & ~(uintptr_t)( align - 1 );
+        if ( start + size <= base + lastChunkSize ) {
+            used = start + size - base;
+            return (void*)start;
+        }
+    }
+
+    // New chunk, with room to align the first allocation
+    size_t needed = size + align;
+    lastChunkSize = needed > chunkSize ? needed : chunkSize;
+    char* chunk = (char*)::operator new ( lastChunkSize );
+    chunks.push_back ( chunk );
+    total += lastChunkSize;
+
+    uintptr_t base = (uintptr_t)chunk;
+    uintptr_t start = ( base + align - 1 ) & ~(uintptr_t)( align - 1 );
+    used = start + size - base;
+    return (void*)start;
+}
+
+void LE_ObjectArena::release () {
+    for ( char* chunk : chunks ) ::operator delete ( chunk );
+    chunks.clear();
+    used = 0;
+    lastChunkSize = 0;
+    total = 0;
+}
+
+
+void* LE_ObjectPool::acquire () {
+    live++;
+    if ( !freeBlocks.empty() ) {
+        void* block = freeBlocks.back();
+        freeBlocks.pop_back();
+        return block;
+    }
+    return arena->allocate ( blockSize, blockAlign );
+}
+
+void LE_ObjectPool::release ( void* block ) {
+    live--;
+    freeBlocks.push_back ( block );
+}
+
+void LE_ObjectPool::reserve ( size_t count ) {
+    freeBlocks.reserve ( freeBlocks.size() + count );
+    for ( size_t i = 0; i < count; i++ )
+        freeBlocks.push_back ( arena->allocate ( blockSize, blockAlign ) );
+}
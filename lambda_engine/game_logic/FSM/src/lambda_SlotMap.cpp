@@ -0,0 +1,90 @@
+#include "lambda_SlotMap.h"
+
+LE_ObjectSlotMap::Slot* LE_ObjectSlotMap::slot ( LE_ObjectHandle handle ) {
+    if ( handle.index >= slots.size() ) return nullptr;
+    Slot* s = &slots[handle.index];
+    if ( s->generation != handle.generation || s->dense == FREE ) return nullptr;
+    return s;
+}
+
+LE_ObjectHandle LE_ObjectSlotMap::reserve () {
+    Uint32 index;
+    if ( firstFree != FREE ) {
+        index = firstFree;
+        firstFree = slots[index].nextFree;
+    } else {
+        index = slots.size();
+        slots.push_back ( { FREE, 1, FREE } );
+    }
+    slots[index].dense = PENDING;
+    return LE_ObjectHandle ( index, slots[index].generation );
+}
+
+bool LE_ObjectSlotMap::place ( LE_ObjectHandle handle, LE_GameObject* object ) {
+    Slot* s = slot ( handle );
+    if ( s == nullptr || s->dense != PENDING ) return false;
+    s->dense = objects.size();
+    objects.push_back ( object );
+    owners.push_back ( handle.index );
+    return true;
+}
+
+LE_GameObject* LE_ObjectSlotMap::get ( LE_ObjectHandle handle ) {
+    Slot* s = slot ( handle );
+    if ( s == nullptr || s->dense == PENDING ) return nullptr;
+    return objects[s->dense];
+}
+
+LE_GameObject* LE_ObjectSlotMap::erase ( LE_ObjectHandle handle ) {
+    Slot* s = slot ( handle );
+    if ( s == nullptr ) return nullptr;
+
+    LE_GameObject* object = nullptr;
+    if ( s->dense != PENDING ) {
+        object = objects[s->dense];
+        objects[s->dense] = nullptr;
+        holes++;
+    }
+    s->dense = FREE;
+    s->generation++;
+    s->nextFree = firstFree;
+    firstFree = handle.index;
+    return object;
+}
+
+void LE_ObjectSlotMap::compact () {
+    if ( holes == 0 ) return;
+
+    size_t w = 0;
+    for ( size_t i = 0; i < objects.size(); i++ ) {
+        if ( objects[i] == nullptr ) continue;
+        if ( w != i ) {
+            objects[w] = objects[i];
+            owners[w] = owners[i];
+            slots[owners[w]].dense = w;
+        }
+        w++;
+    }
+    objects.resize ( w );
+    owners.resize ( w );
+    holes = 0;
+}
+
+void LE_ObjectSlotMap::reserveCapacity ( size_t count ) {
+    objects.reserve ( objects.size() + count );
+    owners.reserve ( owners.size() + count );
+}
+
+void LE_ObjectSlotMap::clear () {
+    // Slots are kept so old handles keep resolving to nullptr
+    firstFree = FREE;
+    for ( size_t i = slots.size(); i-- > 0; ) {
+        if ( slots[i].dense != FREE ) slots[i].generation++;
+        slots[i].dense = FREE;
+        slots[i].nextFree = firstFree;
+        firstFree = i;
+    }
+    objects.clear();
+    owners.clear();
+    holes = 0;
+}
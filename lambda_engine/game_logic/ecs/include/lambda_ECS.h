@@ -0,0 +1,518 @@
+#ifndef _LAMBDA_ENGINE_ECS_H_
+#define _LAMBDA_ENGINE_ECS_H_
+
+    #include <SDL2/SDL.h>
+    #include <functional>
+    #include <mutex>
+    #include <string>
+    #include <type_traits>
+    #include <unordered_map>
+    #include <utility>
+    #include <vector>
+    #include "lambda_Jobs.h"
+
+    /**
+     * @brief Maximum number of component types
+     * */
+    #define LE_ECS_MAX_COMPONENTS 64
+
+    typedef Uint32 LE_ComponentId;
+
+    class LE_World;
+
+    /**
+     * @brief Reference to an entity of a LE_World
+     *
+     * Like LE_ObjectHandle, it stops resolving once the entity is
+     * destroyed, even if its slot is reused.
+     * */
+    typedef struct LE_Entity {
+        Uint32 index;
+        Uint32 generation;
+
+        LE_Entity (): index(0xFFFFFFFF), generation(0) {}
+
+        LE_Entity ( Uint32 _index, Uint32 _generation ):
+            index(_index), generation(_generation) {}
+
+        bool valid () const { return index != 0xFFFFFFFF; }
+
+        bool operator== ( const LE_Entity& other ) const {
+            return index == other.index && generation == other.generation;
+        }
+
+        bool operator!= ( const LE_Entity& other ) const {
+            return !( *this == other );
+        }
+    } LE_Entity;
+
+    /**
+     * @brief Value used for entities that do not point to any entity
+     * */
+    #define LE_INVALID_ENTITY LE_Entity()
+
+    /**
+     * @brief Give out the next component type id
+     *
+     * Use LE_componentId instead
+     * */
+    LE_ComponentId LE_newComponentId ();
+
+    /**
+     * @brief Id of a component type, given on its first use
+     * */
+    template<typename T>
+    LE_ComponentId LE_componentId () {
+        static const LE_ComponentId id = LE_newComponentId();
+        return id;
+    }
+
+    /**
+     * @brief true when no type is repeated among T
+     * */
+    template<typename... T>
+    struct LE_distinctComponents : std::true_type {};
+
+    template<typename First, typename... Rest>
+    struct LE_distinctComponents<First, Rest...> : std::integral_constant<bool,
+        !( std::is_same<First, Rest>::value || ... ) &&
+        LE_distinctComponents<Rest...>::value> {};
+
+    /**
+     * @brief Storage of one component type inside an archetype
+     *
+     * Rows match the entities of the archetype
+     * */
+    class LE_ComponentColumn
+    {
+        public:
+            virtual ~LE_ComponentColumn () {}
+
+            /**
+             * @brief New empty column of the same type
+             * */
+            virtual LE_ComponentColumn* emptyCopy () = 0;
+
+            /**
+             * @brief Move a row of another column of the same type to the end
+             * */
+            virtual void moveFrom ( LE_ComponentColumn* other, size_t row ) = 0;
+
+            /**
+             * @brief Remove a row, the last row takes its place
+             * */
+            virtual void remove ( size_t row ) = 0;
+
+            virtual void reserve ( size_t count ) = 0;
+    };
+
+    typedef LE_ComponentColumn* (*LE_ColumnMaker) ();
+
+    /**
+     * @brief Contiguous array of T components
+     * */
+    template<typename T>
+    class LE_Column : public LE_ComponentColumn
+    {
+        public:
+            std::vector<T> data;
+
+            static LE_ComponentColumn* make () { return new LE_Column<T>(); }
+
+            LE_ComponentColumn* emptyCopy () override { return make(); }
+
+            void moveFrom ( LE_ComponentColumn* other, size_t row ) override {
+                data.push_back ( std::move ( static_cast<LE_Column<T>*>(other)->data[row] ) );
+            }
+
+            void remove ( size_t row ) override {
+                if ( row + 1 != data.size() ) data[row] = std::move ( data.back() );
+                data.pop_back();
+            }
+
+            void reserve ( size_t count ) override { data.reserve ( count ); }
+    };
+
+    /**
+     * @brief Entities having the same set of components
+     *
+     * Each component type is stored in its own array (structure of
+     * arrays), so systems only touch the components they use.
+     * */
+    class LE_Archetype
+    {
+        friend class LE_World;
+
+        private:
+            /** @brief bit i set when it has the component of id i */
+            Uint64 mask;
+
+            /** @brief columns by component id, nullptr for missing ones */
+            LE_ComponentColumn* columns[LE_ECS_MAX_COMPONENTS];
+
+            std::vector<LE_ComponentId> ids;
+
+            std::vector<LE_Entity> entities;
+
+            /** @brief archetype reached adding or removing a component */
+            LE_Archetype* addEdges[LE_ECS_MAX_COMPONENTS];
+            LE_Archetype* removeEdges[LE_ECS_MAX_COMPONENTS];
+
+            LE_Archetype ( Uint64 archetypeMask );
+
+        public:
+            ~LE_Archetype ();
+
+            /**
+             * @brief Number of entities
+             * */
+            size_t size () { return entities.size(); }
+
+            /**
+             * @brief Components of type T, one per entity
+             *
+             * @return nullptr if the archetype has no T
+             * */
+            template<typename T>
+            T* data () {
+                LE_ComponentColumn* column = columns[LE_componentId<T>()];
+                if ( column == nullptr ) return nullptr;
+                return static_cast<LE_Column<T>*>(column)->data.data();
+            }
+    };
+
+    /**
+     * @brief when a system runs, each frame
+     * */
+    enum class LE_SystemPhase {
+        update,
+        render
+    };
+
+    /**
+     * @brief Work run over a world once per frame
+     * */
+    typedef std::function<void(LE_World*)> LE_SystemFunction;
+
+    /**
+     * @brief Entity component system
+     *
+     * Entities are plain ids, their data are components of any type
+     * stored by archetype, in contiguous arrays per component type.
+     * Systems are functions run each frame, usually going through the
+     * entities having some components with LE_World::each:
+     *
+     * @code
+     * struct Velocity { double x, y; };
+     *
+     * LE_World* world = getWorld(); // inside a LE_GameState
+     * world->create ( LE_Transform{ 10, 10, 0 }, Velocity{ 1, 0 } );
+     * world->addSystem ( "move", []( LE_World* w ) {
+     *     double dt = LE_GAME->getDeltaTime();
+     *     w->each<LE_Transform, Velocity>( [dt]( LE_Entity e, LE_Transform& t, Velocity& v ) {
+     *         t.x += v.x * dt;
+     *         t.y += v.y * dt;
+     *     });
+     * });
+     * @endcode
+     *
+     * Adding or removing components and destroying entities while going
+     * through entities is deferred until the outermost query ends.
+     *
+     * Worlds belong to a LE_GameState, their systems are run by
+     * LE_StateMachine after updating and after rendering the state.
+     *
+     * @see LE_GameState::getWorld
+     * */
+    class LE_World
+    {
+        private:
+            typedef struct EntitySlot {
+                /** @brief nullptr while the entity has no components */
+                LE_Archetype* archetype;
+                Uint32 row;
+                Uint32 generation;
+                Uint32 nextFree;
+                bool alive;
+            } EntitySlot;
+
+            typedef struct System {
+                std::string id;
+                LE_SystemFunction function;
+                LE_SystemPhase phase;
+                const char* profileName;
+                bool enabled;
+            } System;
+
+            std::vector<EntitySlot> slots;
+            Uint32 firstFree;
+            size_t aliveCount;
+
+            std::vector<LE_Archetype*> archetypes;
+            std::unordered_map<Uint64, LE_Archetype*> archetypeIndex;
+
+            /** @brief archetypes reached adding a component to an empty entity */
+            LE_Archetype* emptyEdges[LE_ECS_MAX_COMPONENTS];
+
+            /** @brief queries running */
+            int iterating;
+
+            /** @brief changes made while iterating, guarded by commandMutex */
+            std::mutex commandMutex;
+            std::vector<std::function<void()>> commands;
+
+            std::vector<System> systems;
+
+            EntitySlot* slot ( LE_Entity entity );
+
+            /**
+             * @brief Find or create the archetype of a mask
+             *
+             * Columns are made by makers for ids, and copied from source
+             * for the others
+             * */
+            LE_Archetype* getArchetype ( Uint64 mask, LE_Archetype* source,
+                    const LE_ComponentId* ids, const LE_ColumnMaker* makers, int count );
+
+            LE_Archetype* addTransition ( LE_Archetype* from, LE_ComponentId id, LE_ColumnMaker maker );
+            LE_Archetype* removeTransition ( LE_Archetype* from, LE_ComponentId id );
+
+            /**
+             * @brief Move an entity and the components kept by the target
+             * archetype; components only in the target are left for the
+             * caller to push
+             * */
+            void moveEntity ( LE_Entity entity, EntitySlot* s, LE_Archetype* to );
+
+            void removeRow ( LE_Archetype* archetype, Uint32 row );
+
+            /**
+             * @brief Run a change once no query is running
+             * */
+            void defer ( std::function<void()> command );
+
+            template<typename... T>
+            static Uint64 maskOf () {
+                Uint64 mask = 0;
+                ( ( mask |= (Uint64)1 << LE_componentId<T>() ), ... );
+                return mask;
+            }
+
+            template<typename F, typename... P>
+            static void rows ( const LE_Entity* entities, F& function,
+                    size_t begin, size_t end, P*... columns ) {
+                for ( size_t i = begin; i < end; i++ ) function ( entities[i], columns[i]... );
+            }
+
+        public:
+            LE_World ();
+
+            ~LE_World ();
+
+            /**
+             * @brief Create an entity without components
+             *
+             * Main thread only
+             * */
+            LE_Entity create ();
+
+            /**
+             * @brief Create an entity with components of different types
+             *
+             * Goes straight to its archetype, without moving through the
+             * archetypes of each component. Each type may be given only
+             * once. Main thread only.
+             * */
+            template<typename First, typename... Rest>
+            LE_Entity create ( First first, Rest... rest ) {
+                // One bit and one column per type, a repeated type would
+                // push two rows into its column
+                static_assert ( LE_distinctComponents<First, Rest...>::value,
+                        "LE_World::create takes each component type once" );
+                LE_Entity entity = create();
+                if ( iterating > 0 ) {
+                    add ( entity, std::move ( first ) );
+                    ( add ( entity, std::move ( rest ) ), ... );
+                    return entity;
+                }
+
+                const LE_ComponentId ids[] = { LE_componentId<First>(), LE_componentId<Rest>()... };
+                const LE_ColumnMaker makers[] = { &LE_Column<First>::make, &LE_Column<Rest>::make... };
+                LE_Archetype* archetype = getArchetype ( maskOf<First, Rest...>(), nullptr,
+                        ids, makers, 1 + sizeof...(Rest) );
+
+                static_cast<LE_Column<First>*>(archetype->columns[ids[0]])->data.push_back ( std::move ( first ) );
+                ( static_cast<LE_Column<Rest>*>(archetype->columns[LE_componentId<Rest>()])->data.push_back ( std::move ( rest ) ), ... );
+                archetype->entities.push_back ( entity );
+
+                EntitySlot& s = slots[entity.index];
+                s.archetype = archetype;
+                s.row = archetype->entities.size() - 1;
+                return entity;
+            }
+
+            /**
+             * @brief Destroy an entity and its components
+             * */
+            void destroy ( LE_Entity entity );
+
+            /**
+             * @brief returns true until the entity is destroyed
+             * */
+            bool alive ( LE_Entity entity ) { return slot ( entity ) != nullptr; }
+
+            /**
+             * @brief Add a component to an entity, or replace it
+             * */
+            template<typename T>
+            void add ( LE_Entity entity, T component ) {
+                if ( iterating > 0 ) {
+                    defer ( [this, entity, component]() { add ( entity, component ); } );
+                    return;
+                }
+                EntitySlot* s = slot ( entity );
+                if ( s == nullptr ) return;
+
+                LE_ComponentId id = LE_componentId<T>();
+                LE_Archetype* from = s->archetype;
+                if ( from != nullptr && from->columns[id] != nullptr ) {
+                    static_cast<LE_Column<T>*>(from->columns[id])->data[s->row] = std::move ( component );
+                    return;
+                }
+
+                LE_Archetype* to = addTransition ( from, id, &LE_Column<T>::make );
+                moveEntity ( entity, s, to );
+                static_cast<LE_Column<T>*>(to->columns[id])->data.push_back ( std::move ( component ) );
+            }
+
+            /**
+             * @brief Remove a component from an entity
+             * */
+            template<typename T>
+            void remove ( LE_Entity entity ) {
+                if ( iterating > 0 ) {
+                    defer ( [this, entity]() { remove<T> ( entity ); } );
+                    return;
+                }
+                EntitySlot* s = slot ( entity );
+                if ( s == nullptr ) return;
+
+                LE_ComponentId id = LE_componentId<T>();
+                if ( s->archetype == nullptr || s->archetype->columns[id] == nullptr ) return;
+                moveEntity ( entity, s, removeTransition ( s->archetype, id ) );
+            }
+
+            /**
+             * @brief Get a component of an entity
+             *
+             * The pointer is valid until components are added or removed
+             * from any entity of the same archetype
+             *
+             * @return nullptr if the entity has no T or was destroyed
+             * */
+            template<typename T>
+            T* get ( LE_Entity entity ) {
+                EntitySlot* s = slot ( entity );
+                if ( s == nullptr || s->archetype == nullptr ) return nullptr;
+                T* data = s->archetype->data<T>();
+                return data ? data + s->row : nullptr;
+            }
+
+            template<typename T>
+            bool has ( LE_Entity entity ) { return get<T> ( entity ) != nullptr; }
+
+            /**
+             * @brief Call a function for every entity having all the
+             * components T
+             *
+             * @param function called as function ( LE_Entity, T&... )
+             * */
+            template<typename... T, typename F>
+            void each ( F function ) {
+                Uint64 mask = maskOf<T...>();
+                iterating++;
+                for ( LE_Archetype* archetype : archetypes ) {
+                    if ( ( archetype->mask & mask ) != mask || archetype->entities.empty() ) continue;
+                    rows ( archetype->entities.data(), function, 0, archetype->entities.size(),
+                            archetype->data<T>()... );
+                }
+                if ( --iterating == 0 ) flush();
+            }
+
+            /**
+             * @brief Same as each, splitting entities among LE_JOBS workers
+             *
+             * The function may run concurrently for different entities, it
+             * must only change the components it gets. Adding, removing and
+             * destroying are deferred, creating entities is not allowed.
+             *
+             * @param function called as function ( LE_Entity, T&... )
+             * @param grain entities per job, 0 to let LE_JobSystem::parallelFor choose
+             * */
+            template<typename... T, typename F>
+            void eachParallel ( F function, int grain = 0 ) {
+                Uint64 mask = maskOf<T...>();
+                iterating++;
+                for ( LE_Archetype* archetype : archetypes ) {
+                    if ( ( archetype->mask & mask ) != mask || archetype->entities.empty() ) continue;
+                    LE_Entity* entities = archetype->entities.data();
+                    LE_JOBS->parallelFor ( 0, archetype->entities.size(), [&]( int begin, int end ) {
+                        rows ( entities, function, begin, end, archetype->data<T>()... );
+                    }, grain );
+                }
+                if ( --iterating == 0 ) flush();
+            }
+
+            /**
+             * @brief Number of entities having all the components T
+             * */
+            template<typename... T>
+            size_t count () {
+                Uint64 mask = maskOf<T...>();
+                size_t total = 0;
+                for ( LE_Archetype* archetype : archetypes ) {
+                    if ( ( archetype->mask & mask ) == mask ) total += archetype->entities.size();
+                }
+                return total;
+            }
+
+            /**
+             * @brief Number of entities alive
+             * */
+            size_t size () { return aliveCount; }
+
+            /**
+             * @brief Apply the changes deferred by queries
+             *
+             * Called when the outermost query ends
+             * */
+            void flush ();
+
+            /**
+             * @brief Destroy every entity, systems are kept
+             * */
+            void clear ();
+
+            /**
+             * @brief Add a system, run in the order they were added
+             *
+             * @param systemId
+             * @param function
+             * @param phase run after updating or after rendering the state
+             * */
+            void addSystem ( std::string systemId, LE_SystemFunction function,
+                    LE_SystemPhase phase = LE_SystemPhase::update );
+
+            void popSystem ( std::string systemId );
+
+            void enableSystem ( std::string systemId, bool state = true );
+
+            /**
+             * @brief Run the enabled systems of a phase
+             *
+             * Called by LE_StateMachine
+             * */
+            void runSystems ( LE_SystemPhase phase );
+    };
+
+#endif
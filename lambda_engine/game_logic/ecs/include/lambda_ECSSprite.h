@@ -0,0 +1,54 @@
+#ifndef _LAMBDA_ENGINE_ECS_SPRITE_H_
+#define _LAMBDA_ENGINE_ECS_SPRITE_H_
+
+    #include <string>
+    #include "lambda_ECS.h"
+    #include "lambda_TextureManager.h"
+
+    /**
+     * @brief Position and rotation of an entity in the world
+     * */
+    typedef struct LE_Transform {
+        double x;
+        double y;
+        double angle;
+    } LE_Transform;
+
+    /**
+     * @brief Tile drawn at the LE_Transform of an entity
+     *
+     * Same draw members as LE_GameObject, the tile is resolved once.
+     * */
+    typedef struct LE_Sprite {
+        LE_TileHandle tile;
+        Uint32 windowId;
+        double h;
+        double w;
+        bool scale;
+        bool flipv;
+        bool fliph;
+        int layer;
+        int z;
+        bool screenSpace;
+
+        LE_Sprite (): tile(LE_INVALID_TILE_HANDLE), windowId(0), h(1), w(1),
+            scale(true), flipv(false), fliph(false), layer(0), z(0),
+            screenSpace(false) {}
+
+        LE_Sprite ( Uint32 _windowId, const std::string& tileId, int _layer = 0, int _z = 0 ):
+            tile(LE_TEXTURE->resolveTile(_windowId, tileId)), windowId(_windowId),
+            h(1), w(1), scale(true), flipv(false), fliph(false),
+            layer(_layer), z(_z), screenSpace(false) {}
+    } LE_Sprite;
+
+    /**
+     * @brief Render system drawing every entity with a LE_Transform and
+     * a LE_Sprite
+     *
+     * Add it with world->addSystem ( "sprites", LE_DrawSprites, LE_SystemPhase::render ).
+     * With dirty tracking on, systems moving sprites must mark their
+     * windows dirty, LE_TextureManager::markDirty.
+     * */
+    void LE_DrawSprites ( LE_World* world );
+
+#endif
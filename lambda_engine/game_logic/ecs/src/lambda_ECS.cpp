@@ -0,0 +1,226 @@
+#include "lambda_ECS.h"
+#include "lambda_Profiler.h"
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+
+LE_ComponentId LE_newComponentId () {
+    static std::atomic<LE_ComponentId> next ( 0 );
+    LE_ComponentId id = next++;
+    if ( id >= LE_ECS_MAX_COMPONENTS ) {
+        // Masks can't hold it, nothing sensible can be done from here
+        std::cerr << "Too many ECS component types, the maximum is " <<
+            LE_ECS_MAX_COMPONENTS << std::endl;
+        std::abort();
+    }
+    return id;
+}
+
+
+LE_Archetype::LE_Archetype ( Uint64 archetypeMask ): mask(archetypeMask) {
+    for ( int i = 0; i < LE_ECS_MAX_COMPONENTS; i++ ) {
+        columns[i] = nullptr;
+        addEdges[i] = nullptr;
+        removeEdges[i] = nullptr;
+    }
+}
+
+LE_Archetype::~LE_Archetype () {
+    for ( LE_ComponentId id : ids ) delete columns[id];
+}
+
+
+LE_World::LE_World (): firstFree(0xFFFFFFFF), aliveCount(0), iterating(0) {
+    for ( int i = 0; i < LE_ECS_MAX_COMPONENTS; i++ ) emptyEdges[i] = nullptr;
+}
+
+LE_World::~LE_World () {
+    for ( LE_Archetype* archetype : archetypes ) delete archetype;
+}
+
+LE_World::EntitySlot* LE_World::slot ( LE_Entity entity ) {
+    if ( entity.index >= slots.size() ) return nullptr;
+    EntitySlot* s = &slots[entity.index];
+    if ( !s->alive || s->generation != entity.generation ) return nullptr;
+    return s;
+}
+
+LE_Entity LE_World::create () {
+    Uint32 index;
+    if ( firstFree != 0xFFFFFFFF ) {
+        index = firstFree;
+        firstFree = slots[index].nextFree;
+    } else {
+        index = slots.size();
+        slots.push_back ( { nullptr, 0, 1, 0xFFFFFFFF, false } );
+    }
+
+    EntitySlot& s = slots[index];
+    s.archetype = nullptr;
+    s.row = 0;
+    s.alive = true;
+    aliveCount++;
+    return LE_Entity ( index, s.generation );
+}
+
+void LE_World::destroy ( LE_Entity entity ) {
+    if ( iterating > 0 ) {
+        defer ( [this, entity]() { destroy ( entity ); } );
+        return;
+    }
+    EntitySlot* s = slot ( entity );
+    if ( s == nullptr ) return;
+
+    if ( s->archetype != nullptr ) removeRow ( s->archetype, s->row );
+    s->archetype = nullptr;
+    s->alive = false;
+    s->generation++;
+    s->nextFree = firstFree;
+    firstFree = entity.index;
+    aliveCount--;
+}
+
+LE_Archetype* LE_World::getArchetype ( Uint64 mask, LE_Archetype* source,
+        const LE_ComponentId* ids, const LE_ColumnMaker* makers, int count ) {
+    auto it = archetypeIndex.find ( mask );
+    if ( it != archetypeIndex.end() ) return it->second;
+
+    LE_Archetype* archetype = new LE_Archetype ( mask );
+    for ( LE_ComponentId id = 0; id < LE_ECS_MAX_COMPONENTS; id++ ) {
+        if ( ( mask & ( (Uint64)1 << id ) ) == 0 ) continue;
+
+        LE_ComponentColumn* column = nullptr;
+        for ( int i = 0; i < count && column == nullptr; i++ ) {
+            if ( ids[i] == id ) column = makers[i]();
+        }
+        if ( column == nullptr ) column = source->columns[id]->emptyCopy();
+
+        archetype->columns[id] = column;
+        archetype->ids.push_back ( id );
+    }
+
+    archetypes.push_back ( archetype );
+    archetypeIndex[mask] = archetype;
+    return archetype;
+}
+
+LE_Archetype* LE_World::addTransition ( LE_Archetype* from, LE_ComponentId id, LE_ColumnMaker maker ) {
+    LE_Archetype** edge = from ? &from->addEdges[id] : &emptyEdges[id];
+    if ( *edge == nullptr ) {
+        Uint64 mask = ( from ? from->mask : 0 ) | ( (Uint64)1 << id );
+        *edge = getArchetype ( mask, from, &id, &maker, 1 );
+    }
+    return *edge;
+}
+
+LE_Archetype* LE_World::removeTransition ( LE_Archetype* from, LE_ComponentId id ) {
+    Uint64 mask = from->mask & ~( (Uint64)1 << id );
+    // Entities without components don't belong to any archetype
+    if ( mask == 0 ) return nullptr;
+
+    if ( from->removeEdges[id] == nullptr )
+        from->removeEdges[id] = getArchetype ( mask, from, nullptr, nullptr, 0 );
+    return from->removeEdges[id];
+}
+
+void LE_World::moveEntity ( LE_Entity entity, EntitySlot* s, LE_Archetype* to ) {
+    LE_Archetype* from = s->archetype;
+    if ( to != nullptr ) {
+        if ( from != nullptr ) {
+            for ( LE_ComponentId id : to->ids ) {
+                if ( from->columns[id] ) to->columns[id]->moveFrom ( from->columns[id], s->row );
+            }
+        }
+        to->entities.push_back ( entity );
+    }
+    if ( from != nullptr ) removeRow ( from, s->row );
+
+    s->archetype = to;
+    s->row = to ? to->entities.size() - 1 : 0;
+}
+
+void LE_World::removeRow ( LE_Archetype* archetype, Uint32 row ) {
+    for ( LE_ComponentId id : archetype->ids ) archetype->columns[id]->remove ( row );
+
+    std::vector<LE_Entity>& entities = archetype->entities;
+    if ( row + 1 != entities.size() ) {
+        entities[row] = entities.back();
+        slots[entities[row].index].row = row;
+    }
+    entities.pop_back();
+}
+
+void LE_World::defer ( std::function<void()> command ) {
+    std::lock_guard<std::mutex> lock ( commandMutex );
+    commands.push_back ( command );
+}
+
+void LE_World::flush () {
+    std::vector<std::function<void()>> pending;
+    {
+        std::lock_guard<std::mutex> lock ( commandMutex );
+        pending.swap ( commands );
+    }
+    for ( auto& command : pending ) command();
+}
+
+void LE_World::clear () {
+    if ( iterating > 0 ) {
+        std::cerr << "LE_World::clear can't be called from a query" << std::endl;
+        return;
+    }
+
+    for ( LE_Archetype* archetype : archetypes ) delete archetype;
+    archetypes.clear();
+    archetypeIndex.clear();
+    for ( int i = 0; i < LE_ECS_MAX_COMPONENTS; i++ ) emptyEdges[i] = nullptr;
+
+    // Slots are kept so old entities keep being dead
+    firstFree = 0xFFFFFFFF;
+    for ( size_t i = slots.size(); i-- > 0; ) {
+        if ( slots[i].alive ) slots[i].generation++;
+        slots[i].archetype = nullptr;
+        slots[i].alive = false;
+        slots[i].nextFree = firstFree;
+        firstFree = i;
+    }
+    aliveCount = 0;
+    commands.clear();
+}
+
+void LE_World::addSystem ( std::string systemId, LE_SystemFunction function,
+        LE_SystemPhase phase ) {
+    for ( System& system : systems ) {
+        if ( system.id == systemId ) {
+            std::cerr << "System " << systemId << " already exists" << std::endl;
+            return;
+        }
+    }
+    systems.push_back ( { systemId, function, phase,
+            LE_PROFILER->intern ( "system " + systemId ), true } );
+}
+
+void LE_World::popSystem ( std::string systemId ) {
+    for ( auto it = systems.begin(); it != systems.end(); it++ ) {
+        if ( it->id == systemId ) {
+            systems.erase ( it );
+            return;
+        }
+    }
+}
+
+void LE_World::enableSystem ( std::string systemId, bool state ) {
+    for ( System& system : systems ) {
+        if ( system.id == systemId ) system.enabled = state;
+    }
+}
+
+void LE_World::runSystems ( LE_SystemPhase phase ) {
+    // Index loop, systems may add other systems
+    for ( size_t i = 0; i < systems.size(); i++ ) {
+        if ( !systems[i].enabled || systems[i].phase != phase ) continue;
+        LE_PROFILE_SCOPE ( systems[i].profileName );
+        LE_SystemFunction function = systems[i].function;
+        function ( this );
+    }
+}
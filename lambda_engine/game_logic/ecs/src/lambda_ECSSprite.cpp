@@ -0,0 +1,9 @@
+#include "lambda_ECSSprite.h"
+
+void LE_DrawSprites ( LE_World* world ) {
+    LE_TextureManager* tm = LE_TEXTURE;
+    world->each<LE_Transform, LE_Sprite>( [tm]( LE_Entity e, LE_Transform& t, LE_Sprite& s ) {
+        tm->draw ( s.tile, t.x, t.y, s.h, s.w, s.scale, s.flipv, s.fliph,
+                t.angle, s.layer, s.z, s.screenSpace );
+    });
+}
@@ -4,6 +4,7 @@
 #include <map>
 #include <string>
 #include <functional>
+#include <atomic>
 
 /**
  * @brief Global accessor macro for the LE_Events singleton.
@@ -45,6 +46,11 @@ class LE_EventBus
 
     public:
 
+        /**
+         * @brief Number of events emitted by every bus.
+         */
+        static std::atomic<unsigned long long> emitCount;
+
         /**
          * @brief Constructs an empty event bus.
          */
@@ -185,6 +191,13 @@ class LE_Events
          */
         void emit (std::string busId, void* eventData);
 
+        /**
+         * @brief Returns the number of events emitted since the start.
+         *
+         * Compare two calls to get the events emitted in between.
+         */
+        unsigned long long getEmitCount () { return LE_EventBus::emitCount.load(); }
+
         /**
          * @brief Deletes all dynamically allocated buses.
          */
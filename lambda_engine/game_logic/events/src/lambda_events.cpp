@@ -1,6 +1,7 @@
 #include "lambda_events.h"
 
 LE_Events* LE_Events::the_instance = nullptr;
+std::atomic<unsigned long long> LE_EventBus::emitCount ( 0 );
 LE_EventBus::LE_EventBus() {}
 
 LE_EventBus::~LE_EventBus() {}
@@ -17,6 +18,7 @@ void LE_EventBus::unsubscribe(std::string listenerId) {
 }
 
 void LE_EventBus::emit(void* eventData) {
+    emitCount.fetch_add(1, std::memory_order_relaxed);
     for (auto it = listeners.begin(); it != listeners.end(); it++) {
         Callback cb = it->second;
         cb(eventData);
@@ -4,6 +4,8 @@
     #include "lambda_TextureManager.h"
     #include <vector>
 
+    class LE_PerfOverlay;
+
     /**
      * @brief Shortcut to calling the LE_Game instance
      * */
@@ -14,6 +16,27 @@
      * */
     #define QUIT_LE_GAME LE_Game::destroyInstance()
 
+    /**
+     * @brief number of recent frames kept for LE_Game::getFrameStats
+     * */
+    #define LE_FRAME_STATS_SIZE 240
+
+    /**
+     * @brief Frame times of the recent frames, in milliseconds
+     *
+     * Frame time is the whole loop iteration, including the time waited
+     * by the framerate limiter
+     * */
+    typedef struct LE_FrameStats {
+        int frames;
+        double min;
+        double avg;
+        double p99;
+        double max;
+        /** @brief standard deviation of the frame times */
+        double jitter;
+    } LE_FrameStats;
+
     /**
      * @brief Holds the base game structure, defines the main loop functionality
      * */
@@ -30,6 +53,36 @@
              * */
             std::vector<Uint32> windows;
 
+            /**
+             * @brief windows being drawn this frame
+             *
+             * @see LE_TextureManager::setDirtyTracking
+             * */
+            std::vector<Uint32> redrawWindows;
+
+            /**
+             * @brief performance overlay, nullptr while disabled
+             * */
+            LE_PerfOverlay* perfOverlay;
+
+            /**
+             * @brief If true, the game updates as fast as it can with a
+             * synthetic deltaTime and renders only every renderEvery frames
+             *
+             * @see LE_Game::setFastForward
+             * */
+            bool fastForward;
+            int renderEvery;
+            double fastForwardDelta;
+
+            /** @brief updates run in fast-forward, to render every Nth */
+            Uint64 fastForwardSteps;
+
+            /**
+             * @brief Runs one fast-forward update, rendering if due
+             * */
+            void stepFastForward ();
+
             /**
              * @brief If ture, the framerate is fixed to LE_Game::framerate
              * */
@@ -46,6 +99,67 @@
              * */
             double deltaTime;
 
+            /**
+             * @brief If true, the game is updated in steps of LE_Game::timestep
+             * */
+            bool timestepFixed;
+
+            /**
+             * @brief simulated time of each update in milliseconds, when
+             * LE_Game::timestepFixed is set
+             * */
+            double timestep;
+
+            /**
+             * @brief maximum updates per frame, when the game falls behind
+             * further the time left is dropped
+             * */
+            int maxSteps;
+
+            /**
+             * @brief time waiting to be simulated in milliseconds
+             * */
+            double accumulator;
+
+            /**
+             * @brief fraction of a step between the last update and the time
+             * being rendered
+             * */
+            double alpha;
+
+            /**
+             * @brief Runs the updates due with a fixed timestep, then renders
+             * */
+            void stepFixed ();
+
+            /**
+             * @brief performance counter value when the next frame is due,
+             * when LE_Game::framerateFixed is set
+             * */
+            Uint64 nextFrame;
+
+            /**
+             * @brief Wait until the next frame is due
+             *
+             * Sleeps until close to the deadline, then spins for the
+             * last part, since sleeping is only accurate to the scheduler
+             * granularity. Deadlines advance by a whole period so errors
+             * don't add up, and are restarted when a frame is late.
+             * */
+            void waitNextFrame ();
+
+            /**
+             * @brief recent frame times, a ring buffer of
+             * LE_FRAME_STATS_SIZE frames
+             * */
+            std::vector<double> frameTimes;
+            size_t frameTimesNext;
+
+            /**
+             * @brief Add a frame time to LE_Game::frameTimes
+             * */
+            void recordFrame ( double ms );
+
             /**
              * @brief Stores the LE_Game instance
              * */
@@ -93,6 +207,109 @@
              * */
             void unfixFramerate ();
 
+            /**
+             * @brief Get frame time statistics of the last
+             * LE_FRAME_STATS_SIZE frames
+             *
+             * Useful to check the frame pacing, a steady fixed framerate
+             * has min, avg and p99 close to 1000 / fps and a small jitter.
+             * All fields are 0 before the first frame.
+             * */
+            LE_FrameStats getFrameStats ();
+
+            /**
+             * @brief Forget the recorded frame times
+             * */
+            void resetFrameStats ();
+
+            /**
+             * @brief Show performance counters on top of a window
+             *
+             * FPS, frame times and their graph, draw calls, texture memory,
+             * object and group counts of the current state and events
+             * emitted per frame. The key shows and hides it, so it can stay
+             * enabled on deployed builds.
+             *
+             * @param windowId
+             * @param toggleKey
+             * */
+            void enablePerfOverlay ( Uint32 windowId, SDL_Scancode toggleKey = SDL_SCANCODE_F3 );
+
+            /**
+             * @brief Remove the performance overlay
+             * */
+            void disablePerfOverlay ();
+
+            /**
+             * @brief Update the game in steps of a fixed duration
+             *
+             * Each frame, the time passed is measured with the performance
+             * counter and simulated with 0 or more updates of exactly
+             * 1000 / rate milliseconds, LE_Game::getDeltaTime always returns
+             * that step. Physics then behave the same at any framerate.
+             *
+             * If updates take longer than the time they simulate, the game
+             * would fall further behind each frame; at most maxSteps updates
+             * run per frame and the time left is dropped, so the game slows
+             * down instead.
+             *
+             * Rendering happens between updates, use LE_Game::getAlpha, or
+             * LE_GameObject interpolated positions, to draw motion smoothly.
+             *
+             * Events are handled once per frame, and keys released are seen
+             * by the first update of the frame.
+             *
+             * @param rate updates per second
+             * @param maxSteps maximum updates per frame
+             * */
+            void fixTimestep ( int rate, int maxSteps = 5 );
+
+            /**
+             * @brief Update once per frame with the measured deltaTime
+             * */
+            void unfixTimestep ();
+
+            /**
+             * @brief Run game logic as fast as possible
+             *
+             * For soak tests and tuning AI, the main loop and runFrames
+             * update without limiting the framerate, every update simulates
+             * the same delta time, and rendering is skipped except every
+             * renderEvery updates. Updates are then only bounded by the game
+             * logic, and the game can run without any window.
+             *
+             * Events are still handled on every update.
+             *
+             * @param enabled
+             * @param renderEvery render one update out of renderEvery,
+             * 0 to never render
+             * @param delta simulated milliseconds per update, 0 for the
+             * fixed timestep or 1000 / framerate
+             * */
+            void setFastForward ( bool enabled, int renderEvery = 0, double delta = 0 );
+
+            /**
+             * @brief returns true while fast-forwarding
+             * */
+            bool isFastForward () { return fastForward; }
+
+            /**
+             * @brief returns true if the timestep is fixed
+             * */
+            bool isTimestepFixed () { return timestepFixed; }
+
+            /**
+             * @brief Interpolation factor between the previous and the last update
+             *
+             * With a fixed timestep, the fraction of a step passed since
+             * the last update, in [0, 1). Drawing previous + (current -
+             * previous) * alpha shows motion at the time being rendered,
+             * one step behind the simulation.
+             *
+             * Always 1 when the timestep isn't fixed
+             * */
+            double getAlpha () { return alpha; }
+
             /**
              * @brief Creates a new window
              *
@@ -127,6 +344,13 @@
              * */
             Uint32 getWindow ( int idx );
 
+            /**
+             * @brief windows being drawn on the current frame
+             *
+             * Valid while rendering, every window unless dirty tracking is on
+             * */
+            const std::vector<Uint32>& getRedrawWindows () { return redrawWindows; }
+
             /**
              * @brief returns true if the game loop is still running
              * */
@@ -144,6 +368,15 @@
              * */
             void handleEvents ();
 
+            /**
+             * @brief Runs the work sent to the main thread by jobs and
+             * creates the textures loaded asynchronously
+             *
+             * Called once per frame before updating, however many updates
+             * the frame runs, so the texture upload budget holds.
+             * */
+            void processMainThreadWork ();
+
             /**
              * @brief Updates LE_StateMachine LE_State Objects
              * */
@@ -152,9 +385,20 @@
             /**
              * @brief Clears the background, render all active objects and presents them
              * to the window they each belong to
+             *
+             * When dirty tracking is enabled only the windows marked dirty
+             * are drawn, and nothing is drawn if none of them changed.
+             *
+             * States are rendered once per camera of the windows, see
+             * LE_TextureManager::addCamera
              * */
             void render ();
 
+            /**
+             * @brief Runs one frame: handles events, updates and renders
+             * */
+            void step ();
+
             /**
              * @brief deallocates class memory
              * */
@@ -169,6 +413,22 @@
              * @brief Starts Game main loop
              * */
             void mainLoop ();
+
+            /**
+             * @brief Runs a number of frames as fast as possible
+             *
+             * Intended for benchmarks and golden tests, usually with
+             * \ref LE_Init "LE_Init(true)". The framerate is not limited and
+             * LE_Game::deltaTime is 1000 / framerate on every frame, so runs
+             * are repeatable. In fast-forward, frames are run as by
+             * LE_Game::setFastForward. Stops early if LE_Game::exit is called, and
+             * doesn't clean the game, so frames can be checked afterwards
+             * with LE_TextureManager::frameChecksum.
+             *
+             * @param frames
+             * @return time spent in milliseconds
+             * */
+            double runFrames ( int frames );
     };
 
 
@@ -1,6 +1,11 @@
 #include "lambda_Game.h"
 #include "lambda_InputHandler.h"
 #include "lambda_FSM.h"
+#include "lambda_Jobs.h"
+#include "lambda_Profiler.h"
+#include "lambda_PerfOverlay.h"
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 
 using namespace std;
@@ -11,6 +16,19 @@ LE_Game::LE_Game () {
                 running = false;
                 framerateFixed = false;
                 framerate = 30;
+                deltaTime = 0;
+                nextFrame = 0;
+                perfOverlay = nullptr;
+                fastForward = false;
+                renderEvery = 0;
+                fastForwardDelta = 0;
+                fastForwardSteps = 0;
+                frameTimesNext = 0;
+                timestepFixed = false;
+                timestep = 1000.0 / 60;
+                maxSteps = 5;
+                accumulator = 0;
+                alpha = 1;
             }
 
 LE_Game::~LE_Game () { clean(); }
@@ -33,12 +51,113 @@ void LE_Game::destroyInstance() {
 double LE_Game::getDeltaTime () { return deltaTime; }
 
 void LE_Game::fixFramerate ( int fps ) {
+    if ( fps < 1 ) {
+        std::cerr << "Invalid framerate: " << fps << std::endl;
+        return;
+    }
     framerate = fps;
     framerateFixed = true;
 }
 
 void LE_Game::unfixFramerate () { framerateFixed = false; }
 
+void LE_Game::waitNextFrame () {
+    Uint64 frequency = SDL_GetPerformanceFrequency();
+    Uint64 period = frequency / framerate;
+    // Sleeps can overshoot by a couple of milliseconds, spin the rest
+    Uint64 spin = frequency * 2 / 1000;
+
+    nextFrame += period;
+    Uint64 now = SDL_GetPerformanceCounter();
+    if ( now >= nextFrame ) {
+        // Late, pace the next frames from now instead of catching up
+        nextFrame = now;
+        return;
+    }
+
+    while ( now < nextFrame ) {
+        Uint64 left = nextFrame - now;
+        if ( left > spin ) {
+            SDL_Delay ( (Uint32)( ( left - spin ) * 1000 / frequency ) );
+        }
+        now = SDL_GetPerformanceCounter();
+    }
+}
+
+void LE_Game::recordFrame ( double ms ) {
+    if ( frameTimes.size() < LE_FRAME_STATS_SIZE ) {
+        frameTimes.push_back ( ms );
+    } else {
+        frameTimes[frameTimesNext] = ms;
+    }
+    frameTimesNext = ( frameTimesNext + 1 ) % LE_FRAME_STATS_SIZE;
+}
+
+LE_FrameStats LE_Game::getFrameStats () {
+    LE_FrameStats stats = { 0, 0, 0, 0, 0, 0 };
+    if ( frameTimes.empty() ) return stats;
+
+    std::vector<double> sorted ( frameTimes );
+    std::sort ( sorted.begin(), sorted.end() );
+
+    double sum = 0;
+    for ( double ms : sorted ) sum += ms;
+
+    stats.frames = (int)sorted.size();
+    stats.min = sorted.front();
+    stats.max = sorted.back();
+    stats.avg = sum / stats.frames;
+    stats.p99 = sorted[( sorted.size() - 1 ) * 99 / 100];
+
+    double variance = 0;
+    for ( double ms : sorted ) variance += ( ms - stats.avg ) * ( ms - stats.avg );
+    stats.jitter = std::sqrt ( variance / stats.frames );
+
+    return stats;
+}
+
+void LE_Game::resetFrameStats () {
+    frameTimes.clear();
+    frameTimesNext = 0;
+}
+
+void LE_Game::setFastForward ( bool enabled, int every, double delta ) {
+    fastForward = enabled;
+    renderEvery = std::max ( 0, every );
+    fastForwardDelta = std::max ( 0.0, delta );
+    fastForwardSteps = 0;
+
+    // Don't simulate the time spent fast-forwarding again
+    accumulator = 0;
+}
+
+void LE_Game::enablePerfOverlay ( Uint32 windowId, SDL_Scancode toggleKey ) {
+    disablePerfOverlay();
+    perfOverlay = new LE_PerfOverlay ( windowId, toggleKey );
+}
+
+void LE_Game::disablePerfOverlay () {
+    if ( perfOverlay != nullptr ) {
+        delete perfOverlay;
+        perfOverlay = nullptr;
+    }
+}
+
+void LE_Game::fixTimestep ( int rate, int steps ) {
+    if ( rate < 1 ) {
+        std::cerr << "Invalid timestep rate: " << rate << std::endl;
+        return;
+    }
+    timestep = 1000.0 / rate;
+    maxSteps = std::max ( 1, steps );
+    timestepFixed = true;
+}
+
+void LE_Game::unfixTimestep () {
+    timestepFixed = false;
+    alpha = 1;
+}
+
 Uint32 LE_Game::createWindow ( const char* title, int w, int h,
         bool full_screen, bool input_focus,
         bool hidden, bool borderless,
@@ -65,25 +184,143 @@ bool LE_Game::isRunning ( void ) { return running; }
 void LE_Game::setRunning ( bool state ) { running = state; }
 
 void LE_Game::handleEvents () {
+    LE_PROFILE_SCOPE ( "handleEvents" );
     LE_INPUT->update();
+
+    // Fixed timesteps are driven by the time accumulated instead
+    LE_INPUT->logFrame ( timestepFixed && !fastForward ? &accumulator : &deltaTime );
+}
+
+void LE_Game::processMainThreadWork () {
+    LE_JOBS->processMainThread();
+    LE_TEXTURE->processAsyncLoads();
 }
 
 inline void LE_Game::update () {
+    LE_PROFILE_SCOPE ( "update" );
     LE_StateMachine::Instance()->update();
 }
 
 void LE_Game::render () {
+    LE_PROFILE_SCOPE ( "render" );
+    LE_TEXTURE->beginFrame();
+
+    if ( perfOverlay != nullptr ) perfOverlay->update();
+
+    // With dirty tracking, unchanged windows keep showing their last frame
+    redrawWindows.clear();
     for ( Uint32 windowId : windows ) {
+        if ( LE_TEXTURE->beginRedraw( windowId ) ) redrawWindows.push_back ( windowId );
+    }
+    if ( redrawWindows.empty() ) return;
+
+    for ( Uint32 windowId : redrawWindows ) {
         LE_TEXTURE->fillBackground( windowId, 0, 0, 0, 0 );
     }
 
-    LE_FSM->render();
+    // The scene is drawn once per camera, windows without cameras only once
+    int passes = 1;
+    for ( Uint32 windowId : redrawWindows ) {
+        passes = std::max ( passes, LE_TEXTURE->getCameraCount( windowId ) );
+    }
 
-    for ( Uint32 windowId : windows ) {
+    for ( int pass = 0; pass < passes; pass++ ) {
+        for ( Uint32 windowId : redrawWindows ) {
+            LE_TEXTURE->beginCameraPass( windowId, pass );
+        }
+
+        LE_FSM->render();
+
+        for ( Uint32 windowId : redrawWindows ) {
+            LE_TEXTURE->endCameraPass( windowId );
+        }
+    }
+
+    if ( perfOverlay != nullptr &&
+         std::find ( redrawWindows.begin(), redrawWindows.end(),
+             perfOverlay->getWindowId() ) != redrawWindows.end() ) {
+        perfOverlay->render();
+    }
+
+    LE_PROFILE_SCOPE ( "present" );
+    for ( Uint32 windowId : redrawWindows ) {
         LE_TEXTURE->present( windowId );
     }
 }
 
+void LE_Game::step () {
+    handleEvents();
+    processMainThreadWork();
+    update();
+    LE_INPUT->setReleasedToIddle();
+    render();
+}
+
+void LE_Game::stepFixed () {
+    handleEvents();
+    processMainThreadWork();
+
+    // Drop the time that can't be simulated instead of falling further behind
+    double maxTime = timestep * maxSteps;
+    if ( accumulator > maxTime ) accumulator = maxTime;
+
+    deltaTime = timestep;
+
+    bool updated = false;
+    while ( accumulator >= timestep && running ) {
+        update();
+        // Released keys are only seen by one update
+        if ( !updated ) {
+            LE_INPUT->setReleasedToIddle();
+            updated = true;
+        }
+        accumulator -= timestep;
+    }
+
+    alpha = std::min ( 1.0, accumulator / timestep );
+    render();
+}
+
+void LE_Game::stepFastForward () {
+    if ( fastForwardDelta > 0 ) deltaTime = fastForwardDelta;
+    else deltaTime = timestepFixed ? timestep : 1000.0 / framerate;
+    alpha = 1;
+
+    handleEvents();
+    processMainThreadWork();
+    update();
+    LE_INPUT->setReleasedToIddle();
+
+    fastForwardSteps++;
+    if ( renderEvery > 0 && fastForwardSteps % renderEvery == 0 ) render();
+}
+
+double LE_Game::runFrames ( int frames ) {
+    if (!LE_TEXTURE->EverythingWasInit()) {
+        std::cerr << "Could not init texture manager" << std::endl;
+        return 0;
+    }
+
+    // Same delta time on every frame, so runs can be compared
+    deltaTime = timestepFixed ? timestep : 1000.0 / framerate;
+    alpha = 1;
+
+    Uint64 start = SDL_GetPerformanceCounter();
+
+    running = true;
+    for ( int i = 0; i < frames && running; i++ ) {
+        Uint64 frameStart = SDL_GetPerformanceCounter();
+        if ( fastForward ) stepFastForward();
+        else step();
+        recordFrame ( ( SDL_GetPerformanceCounter() - frameStart ) * 1000.0 /
+                SDL_GetPerformanceFrequency() );
+        LE_PROFILER->endFrame();
+    }
+
+    return ( SDL_GetPerformanceCounter() - start ) * 1000.0 /
+        SDL_GetPerformanceFrequency();
+}
+
 void LE_Game::mainLoop () {
 
     if (!LE_TEXTURE->EverythingWasInit()) {
@@ -91,35 +328,43 @@ void LE_Game::mainLoop () {
         return;
     }
 
-    Uint32 frameStart, frameTime;
+    Uint64 frequency = SDL_GetPerformanceFrequency();
+    Uint64 lastCounter = SDL_GetPerformanceCounter();
+    nextFrame = lastCounter;
+
+    // The first frame always updates, so states are entered before rendering
+    accumulator = timestep;
 
     running = true;
     while ( running ) {
-        frameStart = SDL_GetTicks();
-
-        handleEvents();
-        update();
-        LE_INPUT->setReleasedToIddle();
-        render();
-
-        frameTime = SDL_GetTicks() - frameStart;
-        if ( framerateFixed ) {
-            // Fix framerate
-            double frameMaxTime = 1000.0f/framerate;
-            if ( frameTime < frameMaxTime ) {
-                SDL_Delay( (int)(frameMaxTime - frameTime) );
-                deltaTime = frameMaxTime;
-            } else {
-                deltaTime = frameTime;
-            }
+        if ( fastForward ) {
+            stepFastForward();
+        } else if ( timestepFixed ) {
+            stepFixed();
         } else {
-            deltaTime = frameTime;
+            alpha = 1;
+            step();
         }
+
+        if ( framerateFixed && !fastForward ) waitNextFrame();
+
+        // Measure the whole iteration, including the wait
+        Uint64 counter = SDL_GetPerformanceCounter();
+        double frameTime = ( counter - lastCounter ) * 1000.0 / frequency;
+        lastCounter = counter;
+
+        recordFrame ( frameTime );
+        LE_PROFILER->endFrame();
+        if ( fastForward ) continue;
+        if ( timestepFixed ) accumulator += frameTime;
+        else deltaTime = frameTime;
     }
     clean();
 }
 
 void LE_Game::clean () {
+    // Its textures belong to a window renderer
+    disablePerfOverlay();
     LE_TEXTURE->clean();
     LE_INPUT->clean();
     LE_FSM->clean();
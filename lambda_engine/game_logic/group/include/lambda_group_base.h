@@ -6,6 +6,7 @@ class LE_GameState;
 
 #include <map>
 #include <string>
+#include <vector>
 
 /**
  * @brief base class for groups
@@ -38,6 +39,31 @@ class LE_Group {
          * @brief Flag, while in false, the group updates won't be executed
          * */
         bool enabled;
+
+        /**
+         * @brief If true, objects are updated on worker threads
+         *
+         * @see LE_Group::setParallel
+         * */
+        bool parallel;
+
+        /**
+         * @brief minimum number of objects to update in parallel
+         * */
+        int parallelThreshold;
+
+        /**
+         * @brief objects in id order, gathered for parallel updates
+         * */
+        std::vector<LE_GameObject*> objectList;
+
+    private:
+        /**
+         * @brief name of the group updates in the profiler, set by
+         * LE_GameState while profiling
+         * */
+        const char* profileName;
+
     public:
 
         LE_Group();
@@ -74,6 +100,18 @@ class LE_Group {
          * */
         virtual void objUpdateHandler(void* gameObj) = 0;
 
+        /**
+         * @brief Executes after every object of a parallel group was updated
+         *
+         * Called on the main thread, for each object in id order. Make the
+         * changes that affect other objects or the engine here (emitting
+         * events, spawning objects...), from what objUpdateHandler left in
+         * the object, so results don't depend on the thread timing.
+         *
+         * @see LE_Group::setParallel
+         * */
+        virtual void objCommitHandler(void* gameObj) {}
+
         /**
          * @brief Executes when a game Object is unregistered from the group
          * */
@@ -83,14 +121,31 @@ class LE_Group {
          * @brief Executes on every game loop
          *
          * If not overwriten, will trigger objUpdateHander() on
-         * every object registered in the group
+         * every object registered in the group, then objCommitHandler()
+         * on every object if the group is parallel
          * */
-        virtual void update () {
-            for ( auto it = gameObjects.begin(); it != gameObjects.end(); ++it ) {
-                void *gObj = it->second;
-                objUpdateHandler(gObj);
-            }
-        }
+        virtual void update ();
+
+        /**
+         * @brief Declare objUpdateHandler safe to run on worker threads
+         *
+         * Objects are split in chunks updated in parallel by LE_JOBS.
+         * objUpdateHandler must only change the object it gets, and read
+         * nothing another object's update changes; the rest goes to
+         * objCommitHandler, run serially afterwards.
+         *
+         * Groups with fewer objects than threshold are updated on the main
+         * thread, where splitting the work costs more than it saves.
+         *
+         * @param state
+         * @param threshold minimum number of objects to update in parallel
+         * */
+        void setParallel ( bool state, int threshold = 64 );
+
+        /**
+         * @brief returns true if the group updates objects in parallel
+         * */
+        bool isParallel () { return parallel; }
 
         /**
          * @brief Set main game object for one to many interactors
@@ -1,8 +1,43 @@
 #include "lambda_group_base.h"
 #include "lambda_GameObject.h"
+#include "lambda_Jobs.h"
 
 LE_Group::LE_Group() {
     enabled = true;
+    parallel = false;
+    parallelThreshold = 64;
+    profileName = nullptr;
+}
+
+void LE_Group::update () {
+    if ( !parallel ) {
+        for ( auto it = gameObjects.begin(); it != gameObjects.end(); ++it ) {
+            void *gObj = it->second;
+            objUpdateHandler(gObj);
+        }
+        return;
+    }
+
+    objectList.clear();
+    for ( auto it = gameObjects.begin(); it != gameObjects.end(); ++it ) {
+        objectList.push_back ( it->second );
+    }
+
+    if ( (int)objectList.size() < parallelThreshold ) {
+        for ( LE_GameObject* obj : objectList ) objUpdateHandler(obj);
+    } else {
+        LE_JOBS->parallelFor ( 0, objectList.size(), [this]( int begin, int end ) {
+            for ( int i = begin; i < end; i++ ) objUpdateHandler(objectList[i]);
+        } );
+    }
+
+    // Same order whatever the thread timing
+    for ( LE_GameObject* obj : objectList ) objCommitHandler(obj);
+}
+
+void LE_Group::setParallel ( bool state, int threshold ) {
+    parallel = state;
+    parallelThreshold = threshold > 1 ? threshold : 1;
 }
 
 void LE_Group::registerObject ( LE_GameObject* gameObj, std::string objId ) {
@@ -0,0 +1,243 @@
+#ifndef _LAMBDA_ENGINE_JOBS_H_
+#define _LAMBDA_ENGINE_JOBS_H_
+
+    #include <SDL2/SDL.h>
+    #include <atomic>
+    #include <condition_variable>
+    #include <deque>
+    #include <functional>
+    #include <mutex>
+    #include <thread>
+    #include <vector>
+
+    /**
+     * @brief Shortcut to calling the LE_JobSystem instance
+     * */
+    #define LE_JOBS LE_JobSystem::Instance()
+
+    /**
+     * @brief Shortcut to calling the LE_JobSystem destructor
+     * */
+    #define QUIT_LE_JOBS LE_JobSystem::destroyInstance()
+
+    /**
+     * @brief Work run by a job
+     * */
+    typedef std::function<void()> LE_JobFunction;
+
+    /**
+     * @brief Work run by LE_JobSystem::parallelFor over [begin, end)
+     * */
+    typedef std::function<void(int, int)> LE_RangeFunction;
+
+    class LE_JobCounter;
+
+    /**
+     * @brief Job waiting in a queue
+     * */
+    typedef struct LE_Job {
+        LE_JobFunction function;
+
+        /** @brief decremented when the job finishes, may be nullptr */
+        LE_JobCounter* counter;
+    } LE_Job;
+
+    /**
+     * @brief Counts the unfinished jobs started with it
+     *
+     * Used to wait for a group of jobs (fork/join) and to start jobs once
+     * another group is done. It must outlive the jobs started with it.
+     *
+     * @see LE_JobSystem::run
+     * */
+    class LE_JobCounter
+    {
+        friend class LE_JobSystem;
+
+        private:
+            std::atomic<int> count;
+
+            std::mutex mutex;
+
+            /** @brief jobs started once count gets to 0 */
+            std::vector<LE_Job> dependents;
+
+        public:
+            LE_JobCounter (): count(0) {}
+
+            /**
+             * @brief returns true when every job started with the counter
+             * has finished
+             * */
+            bool done () { return count.load() == 0; }
+    };
+
+    /**
+     * @brief Work-stealing thread pool
+     *
+     * Each worker thread has its own queue; jobs started from a worker
+     * go to its queue, and idle workers steal the oldest jobs from the
+     * others. Jobs started from other threads go to a shared queue.
+     *
+     * Threads waiting for a counter run queued jobs meanwhile, so jobs
+     * can start and wait for other jobs without blocking workers.
+     *
+     * SDL rendering and windows can only be used from the main thread,
+     * jobs send that work to LE_JobSystem::runOnMainThread.
+     * */
+    class LE_JobSystem
+    {
+        private:
+            /**
+             * @brief Worker thread and its queue
+             *
+             * The owner takes jobs from the back, thieves from the front
+             * */
+            typedef struct Worker {
+                std::thread thread;
+                std::mutex mutex;
+                std::deque<LE_Job> jobs;
+            } Worker;
+
+            /**
+             * @brief Stores the LE_JobSystem instance
+             * */
+            static LE_JobSystem* the_instance;
+
+            std::vector<Worker*> workers;
+
+            /** @brief jobs started outside of the workers */
+            std::mutex sharedMutex;
+            std::deque<LE_Job> shared;
+
+            /** @brief jobs waiting in any queue */
+            std::atomic<int> queued;
+
+            /** @brief wakes idle workers up */
+            std::mutex sleepMutex;
+            std::condition_variable wake;
+
+            std::atomic<bool> stopping;
+
+            std::thread::id mainThread;
+
+            /** @brief work waiting for the main thread */
+            std::mutex mainMutex;
+            std::vector<LE_JobFunction> mainQueue;
+
+            /**
+             * @brief Class constructor
+             *
+             * Starts one worker less than the number of CPU cores, since
+             * the main thread also runs jobs while waiting
+             * */
+            LE_JobSystem ();
+
+            void workerLoop ( int index );
+
+            /**
+             * @brief queue a job that can run right away
+             * */
+            void push ( const LE_Job& job );
+
+            /**
+             * @brief Take a job, from the own queue first, then the shared
+             * one and then steal from the other workers
+             *
+             * @return false if there was no job
+             * */
+            bool take ( LE_Job* job );
+
+            /**
+             * @brief Run a job and finish it
+             * */
+            void execute ( LE_Job& job );
+
+            /**
+             * @brief Decrement a counter, starting its dependents when it
+             * gets to 0
+             * */
+            void finish ( LE_JobCounter* counter );
+
+        public:
+            /**
+             * @brief Class destructor
+             *
+             * Waits for the jobs being run, jobs still queued are dropped
+             * */
+            ~LE_JobSystem ();
+
+            /**
+             * @brief Get the singleton instance
+             *
+             * Must be created from the main thread
+             * */
+            static LE_JobSystem* Instance ();
+
+            /**
+             * @brief Destroys the LE_JobSystem instance
+             * */
+            static void destroyInstance ();
+
+            /**
+             * @brief Start a job
+             *
+             * @param function work to run on any worker
+             * @param counter incremented now and decremented once the job
+             * finishes, to wait for it; may be nullptr
+             * @param after the job starts once every job of this counter
+             * has finished; nullptr to start right away
+             * */
+            void run ( LE_JobFunction function, LE_JobCounter* counter = nullptr,
+                    LE_JobCounter* after = nullptr );
+
+            /**
+             * @brief Wait until every job of a counter has finished
+             *
+             * Runs other jobs meanwhile; on the main thread, also runs the
+             * work sent to it by LE_JobSystem::runOnMainThread.
+             * */
+            void wait ( LE_JobCounter* counter );
+
+            /**
+             * @brief Run a function over the range [begin, end) split
+             * into chunks run in parallel, and wait for them
+             *
+             * @param begin
+             * @param end
+             * @param function called with the [begin, end) of each chunk
+             * @param grain chunk size, 0 to split the range in a few
+             * chunks per thread
+             * */
+            void parallelFor ( int begin, int end, LE_RangeFunction function, int grain = 0 );
+
+            /**
+             * @brief Send work to the main thread
+             *
+             * It is run at the start of the next game update, or while the
+             * main thread waits for a counter. Runs right away when called
+             * from the main thread.
+             * */
+            void runOnMainThread ( LE_JobFunction function );
+
+            /**
+             * @brief Run the work sent to the main thread
+             *
+             * Called by LE_Game::update
+             *
+             * @return number of functions run
+             * */
+            int processMainThread ();
+
+            /**
+             * @brief returns true when called from the main thread
+             * */
+            bool isMainThread () { return std::this_thread::get_id() == mainThread; }
+
+            /**
+             * @brief Number of worker threads
+             * */
+            int threads () { return workers.size(); }
+    };
+
+#endif
@@ -0,0 +1,203 @@
+#include "lambda_Jobs.h"
+#include <algorithm>
+
+using namespace std;
+
+LE_JobSystem* LE_JobSystem::the_instance;
+
+/**
+ * @brief index of the worker running on this thread, -1 outside of workers
+ * */
+static thread_local int workerIndex = -1;
+
+LE_JobSystem::LE_JobSystem (): queued(0), stopping(false),
+    mainThread(this_thread::get_id()) {
+    int count = max ( 1, SDL_GetCPUCount() - 1 );
+    for ( int i = 0; i < count; i++ ) workers.push_back ( new Worker() );
+    // Start threads once every queue exists, they steal from each other
+    for ( int i = 0; i < count; i++ ) {
+        workers[i]->thread = thread ( &LE_JobSystem::workerLoop, this, i );
+    }
+}
+
+LE_JobSystem::~LE_JobSystem () {
+    {
+        lock_guard<mutex> lock ( sleepMutex );
+        stopping = true;
+    }
+    wake.notify_all();
+    for ( Worker* worker : workers ) worker->thread.join();
+    for ( Worker* worker : workers ) delete worker;
+    workers.clear();
+}
+
+LE_JobSystem* LE_JobSystem::Instance () {
+    if ( the_instance == nullptr ) {
+        the_instance = new LE_JobSystem();
+    }
+    return the_instance;
+}
+
+void LE_JobSystem::destroyInstance () {
+    if ( the_instance != nullptr ) {
+        delete the_instance;
+        the_instance = nullptr;
+    }
+}
+
+void LE_JobSystem::workerLoop ( int index ) {
+    workerIndex = index;
+
+    while ( !stopping ) {
+        LE_Job job;
+        if ( take ( &job ) ) {
+            execute ( job );
+            continue;
+        }
+
+        unique_lock<mutex> lock ( sleepMutex );
+        wake.wait ( lock, [this]() { return stopping || queued.load() > 0; } );
+    }
+}
+
+void LE_JobSystem::push ( const LE_Job& job ) {
+    if ( workerIndex >= 0 ) {
+        Worker* worker = workers[workerIndex];
+        lock_guard<mutex> lock ( worker->mutex );
+        worker->jobs.push_back ( job );
+    } else {
+        lock_guard<mutex> lock ( sharedMutex );
+        shared.push_back ( job );
+    }
+    queued++;
+
+    // Taking the lock makes sure a worker about to sleep sees the job
+    { lock_guard<mutex> lock ( sleepMutex ); }
+    wake.notify_one();
+}
+
+bool LE_JobSystem::take ( LE_Job* job ) {
+    if ( queued.load() == 0 ) return false;
+
+    // Newest job of the own queue, its data is likely still in cache
+    if ( workerIndex >= 0 ) {
+        Worker* worker = workers[workerIndex];
+        lock_guard<mutex> lock ( worker->mutex );
+        if ( !worker->jobs.empty() ) {
+            *job = move ( worker->jobs.back() );
+            worker->jobs.pop_back();
+            queued--;
+            return true;
+        }
+    }
+
+    {
+        lock_guard<mutex> lock ( sharedMutex );
+        if ( !shared.empty() ) {
+            *job = move ( shared.front() );
+            shared.pop_front();
+            queued--;
+            return true;
+        }
+    }
+
+    // Steal the oldest job of another worker, starting after our own
+    int count = workers.size();
+    int first = workerIndex >= 0 ? workerIndex + 1 : 0;
+    for ( int i = 0; i < count; i++ ) {
+        Worker* victim = workers[( first + i ) % count];
+        if ( victim == ( workerIndex >= 0 ? workers[workerIndex] : nullptr ) ) continue;
+
+        lock_guard<mutex> lock ( victim->mutex );
+        if ( !victim->jobs.empty() ) {
+            *job = move ( victim->jobs.front() );
+            victim->jobs.pop_front();
+            queued--;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void LE_JobSystem::execute ( LE_Job& job ) {
+    job.function();
+    if ( job.counter != nullptr ) finish ( job.counter );
+}
+
+void LE_JobSystem::finish ( LE_JobCounter* counter ) {
+    vector<LE_Job> ready;
+    {
+        lock_guard<mutex> lock ( counter->mutex );
+        if ( --counter->count == 0 ) ready.swap ( counter->dependents );
+    }
+    // The counter may not exist anymore once it is unlocked
+    for ( const LE_Job& job : ready ) push ( job );
+}
+
+void LE_JobSystem::run ( LE_JobFunction function, LE_JobCounter* counter,
+        LE_JobCounter* after ) {
+    if ( counter != nullptr ) counter->count++;
+    LE_Job job = { function, counter };
+
+    if ( after != nullptr ) {
+        lock_guard<mutex> lock ( after->mutex );
+        if ( after->count.load() > 0 ) {
+            after->dependents.push_back ( job );
+            return;
+        }
+    }
+    push ( job );
+}
+
+void LE_JobSystem::wait ( LE_JobCounter* counter ) {
+    bool main = isMainThread();
+    while ( !counter->done() ) {
+        LE_Job job;
+        if ( take ( &job ) ) {
+            execute ( job );
+        } else if ( !main || processMainThread() == 0 ) {
+            this_thread::yield();
+        }
+    }
+
+    // Let the last job release the counter before it can be destroyed
+    lock_guard<mutex> lock ( counter->mutex );
+}
+
+void LE_JobSystem::parallelFor ( int begin, int end, LE_RangeFunction function, int grain ) {
+    if ( end <= begin ) return;
+
+    int size = end - begin;
+    if ( grain <= 0 ) grain = max ( 1, size / ( ( threads() + 1 ) * 4 ) );
+    if ( size <= grain ) {
+        function ( begin, end );
+        return;
+    }
+
+    LE_JobCounter counter;
+    for ( int chunk = begin; chunk < end; chunk += min ( grain, end - chunk ) ) {
+        int chunkEnd = chunk + min ( grain, end - chunk );
+        run ( [&function, chunk, chunkEnd]() { function ( chunk, chunkEnd ); }, &counter );
+    }
+    wait ( &counter );
+}
+
+void LE_JobSystem::runOnMainThread ( LE_JobFunction function ) {
+    if ( isMainThread() ) {
+        function();
+        return;
+    }
+    lock_guard<mutex> lock ( mainMutex );
+    mainQueue.push_back ( function );
+}
+
+int LE_JobSystem::processMainThread () {
+    vector<LE_JobFunction> functions;
+    {
+        lock_guard<mutex> lock ( mainMutex );
+        functions.swap ( mainQueue );
+    }
+    for ( LE_JobFunction& function : functions ) function();
+    return functions.size();
+}
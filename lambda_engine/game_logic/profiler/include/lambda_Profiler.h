@@ -0,0 +1,238 @@
+#ifndef _LAMBDA_ENGINE_PROFILER_H_
+#define _LAMBDA_ENGINE_PROFILER_H_
+
+    #include <SDL2/SDL.h>
+    #include <atomic>
+    #include <deque>
+    #include <mutex>
+    #include <set>
+    #include <string>
+    #include <thread>
+    #include <vector>
+
+    /**
+     * @brief Shortcut to calling the LE_Profiler instance
+     * */
+    #define LE_PROFILER LE_Profiler::Instance()
+
+    /**
+     * @brief Shortcut to calling the LE_Profiler destructor
+     * */
+    #define QUIT_LE_PROFILER LE_Profiler::destroyInstance()
+
+    #define LE_PROFILE_CONCAT_( a, b ) a##b
+    #define LE_PROFILE_CONCAT( a, b ) LE_PROFILE_CONCAT_( a, b )
+
+    /**
+     * @brief Measure the rest of the current scope
+     *
+     * name must outlive the profiler, use string literals or
+     * LE_Profiler::intern. Costs a flag check while profiling is disabled.
+     * */
+    #define LE_PROFILE_SCOPE( name ) \
+        LE_ProfileScope LE_PROFILE_CONCAT( leProfileScope, __LINE__ ) ( name )
+
+    /**
+     * @brief Measured scope, times in performance counter ticks
+     * */
+    typedef struct LE_ProfileEvent {
+        const char* name;
+        Uint64 start;
+        Uint64 end;
+        int thread;
+    } LE_ProfileEvent;
+
+    /**
+     * @brief Frame profiler
+     *
+     * Scopes are recorded by each thread into its own ring buffer, with
+     * a single writer and a single reader and no locks. At the end of
+     * each frame, the main thread moves the finished scopes into the
+     * history of the last frames, which can be exported as Chrome
+     * trace_event JSON (chrome://tracing, Perfetto).
+     *
+     * Frames longer than a threshold can also be exported automatically,
+     * to catch hitches when they happen.
+     * */
+    class LE_Profiler
+    {
+        private:
+            /**
+             * @brief Scopes recorded by a thread, waiting for endFrame
+             *
+             * The thread writes at head, the main thread reads at tail.
+             * Scopes are dropped while the ring is full.
+             * */
+            typedef struct ThreadBuffer {
+                int thread;
+                std::string name;
+                std::vector<LE_ProfileEvent> events;
+                std::atomic<Uint64> head;
+                std::atomic<Uint64> tail;
+                std::atomic<Uint64> dropped;
+            } ThreadBuffer;
+
+            /**
+             * @brief Scopes of a finished frame
+             * */
+            typedef struct Frame {
+                Uint64 number;
+                Uint64 start;
+                Uint64 end;
+                std::vector<LE_ProfileEvent> events;
+            } Frame;
+
+            /**
+             * @brief Stores the LE_Profiler instance
+             *
+             * Read by scopes of every thread
+             * */
+            static std::atomic<LE_Profiler*> the_instance;
+
+            /**
+             * @brief increased for every instance, so threads know when
+             * their buffer belongs to a destroyed one
+             * */
+            static std::atomic<int> generation;
+
+            std::thread::id mainThread;
+
+            /** @brief guards buffers and names */
+            std::mutex mutex;
+            std::vector<ThreadBuffer*> buffers;
+            std::set<std::string> names;
+
+            std::deque<Frame> history;
+            size_t historyFrames;
+
+            Uint64 frameNumber;
+            Uint64 frameStart;
+
+            /** @brief trace timestamps are relative to it */
+            Uint64 origin;
+
+            double autoExportMs;
+            std::string autoExportPrefix;
+
+            LE_Profiler ();
+
+            /**
+             * @brief Get the buffer of the calling thread, created on its
+             * first scope
+             * */
+            ThreadBuffer* threadBuffer ();
+
+            /**
+             * @brief Write frames as a Chrome trace
+             * */
+            bool writeTrace ( const std::string& filePath, const std::deque<Frame>& frames );
+
+        public:
+            /**
+             * @brief true while profiling, read by every scope
+             * */
+            static std::atomic<bool> active;
+
+            /**
+             * @brief Class destructor
+             *
+             * Scopes must not be recorded anymore, so destroy it after
+             * every thread that records scopes is stopped: LE_JOBS workers
+             * and the LE_TextureManager loader threads. LE_Quit destroys
+             * it last.
+             * */
+            ~LE_Profiler ();
+
+            /**
+             * @brief Get the singleton instance
+             *
+             * Must be created from the main thread
+             * */
+            static LE_Profiler* Instance ();
+
+            /**
+             * @brief Destroys the LE_Profiler instance
+             * */
+            static void destroyInstance ();
+
+            /**
+             * @brief Record a scope of the calling thread
+             *
+             * Called by LE_ProfileScope
+             * */
+            static void record ( const char* name, Uint64 start, Uint64 end );
+
+            /**
+             * @brief Start recording scopes
+             *
+             * @param frames number of frames kept for exportTrace
+             * */
+            void enable ( size_t frames = 120 );
+
+            /**
+             * @brief Stop recording scopes, the history is kept
+             * */
+            void disable ();
+
+            bool isEnabled () { return active.load(); }
+
+            /**
+             * @brief Get a name for scopes built at runtime
+             *
+             * Returns the same pointer for the same name, valid until the
+             * profiler is destroyed. Takes a lock, keep the result.
+             * */
+            const char* intern ( const std::string& name );
+
+            /**
+             * @brief Close the current frame
+             *
+             * Collects the scopes finished by every thread. Called by
+             * LE_Game at the end of each frame.
+             * */
+            void endFrame ();
+
+            /**
+             * @brief Export the frames kept as a Chrome trace
+             *
+             * @param filePath JSON file
+             * @return false if the file couldn't be written
+             * */
+            bool exportTrace ( const std::string& filePath );
+
+            /**
+             * @brief Export the frames lasting more than a threshold
+             *
+             * Each one is written to prefix + frame number + ".json"
+             *
+             * @param thresholdMs 0 to stop exporting
+             * @param prefix path prefix of the files
+             * */
+            void setAutoExport ( double thresholdMs, const std::string& prefix = "frame_" );
+
+            /**
+             * @brief Number of scopes dropped because a buffer was full
+             * */
+            Uint64 getDropped ();
+    };
+
+    /**
+     * @brief Records its lifetime, see LE_PROFILE_SCOPE
+     * */
+    class LE_ProfileScope
+    {
+        private:
+            const char* name;
+            Uint64 start;
+
+        public:
+            LE_ProfileScope ( const char* scopeName ): name(scopeName),
+                start(LE_Profiler::active.load(std::memory_order_relaxed) ?
+                        SDL_GetPerformanceCounter() : 0) {}
+
+            ~LE_ProfileScope () {
+                if ( start != 0 ) LE_Profiler::record ( name, start, SDL_GetPerformanceCounter() );
+            }
+    };
+
+#endif
@@ -0,0 +1,188 @@
+#include "lambda_Profiler.h"
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+
+/**
+ * @brief scopes each thread can hold between two frames
+ * */
+#define LE_PROFILE_BUFFER_SIZE 16384
+
+atomic<LE_Profiler*> LE_Profiler::the_instance ( nullptr );
+atomic<int> LE_Profiler::generation ( 0 );
+atomic<bool> LE_Profiler::active ( false );
+
+static thread_local void* localBuffer = nullptr;
+static thread_local int localGeneration = -1;
+
+LE_Profiler::LE_Profiler (): mainThread(this_thread::get_id()),
+    historyFrames(120), frameNumber(0), autoExportMs(0) {
+    generation++;
+    origin = frameStart = SDL_GetPerformanceCounter();
+}
+
+LE_Profiler::~LE_Profiler () {
+    active = false;
+    for ( ThreadBuffer* buffer : buffers ) delete buffer;
+}
+
+LE_Profiler* LE_Profiler::Instance () {
+    LE_Profiler* profiler = the_instance.load();
+    if ( profiler == nullptr ) {
+        profiler = new LE_Profiler();
+        the_instance = profiler;
+    }
+    return profiler;
+}
+
+void LE_Profiler::destroyInstance () {
+    // Scopes ending from now on see no profiler
+    LE_Profiler* profiler = the_instance.exchange ( nullptr );
+    delete profiler;
+}
+
+LE_Profiler::ThreadBuffer* LE_Profiler::threadBuffer () {
+    if ( localGeneration == generation.load() ) return (ThreadBuffer*)localBuffer;
+
+    ThreadBuffer* buffer = new ThreadBuffer();
+    buffer->events.resize ( LE_PROFILE_BUFFER_SIZE );
+    buffer->head = 0;
+    buffer->tail = 0;
+    buffer->dropped = 0;
+
+    lock_guard<std::mutex> lock ( mutex );
+    buffer->thread = buffers.size();
+    buffer->name = this_thread::get_id() == mainThread ?
+        "main" : "thread " + to_string ( buffer->thread );
+    buffers.push_back ( buffer );
+
+    localBuffer = buffer;
+    localGeneration = generation.load();
+    return buffer;
+}
+
+void LE_Profiler::record ( const char* name, Uint64 start, Uint64 end ) {
+    LE_Profiler* profiler = the_instance.load ( memory_order_acquire );
+    if ( profiler == nullptr || !active.load ( memory_order_relaxed ) ) return;
+
+    ThreadBuffer* buffer = profiler->threadBuffer();
+    Uint64 head = buffer->head.load ( memory_order_relaxed );
+    if ( head - buffer->tail.load ( memory_order_acquire ) >= LE_PROFILE_BUFFER_SIZE ) {
+        buffer->dropped++;
+        return;
+    }
+
+    buffer->events[head % LE_PROFILE_BUFFER_SIZE] = { name, start, end, buffer->thread };
+    buffer->head.store ( head + 1, memory_order_release );
+}
+
+void LE_Profiler::enable ( size_t frames ) {
+    historyFrames = frames > 0 ? frames : 1;
+    frameStart = SDL_GetPerformanceCounter();
+    active = true;
+}
+
+void LE_Profiler::disable () { active = false; }
+
+const char* LE_Profiler::intern ( const std::string& name ) {
+    lock_guard<std::mutex> lock ( mutex );
+    return names.insert ( name ).first->c_str();
+}
+
+void LE_Profiler::endFrame () {
+    Uint64 now = SDL_GetPerformanceCounter();
+    if ( !active ) {
+        frameStart = now;
+        return;
+    }
+
+    Frame frame = { frameNumber++, frameStart, now, {} };
+    frame.events.push_back ( { "frame", frameStart, now, threadBuffer()->thread } );
+
+    {
+        lock_guard<std::mutex> lock ( mutex );
+        for ( ThreadBuffer* buffer : buffers ) {
+            Uint64 head = buffer->head.load ( memory_order_acquire );
+            Uint64 tail = buffer->tail.load ( memory_order_relaxed );
+            for ( Uint64 i = tail; i < head; i++ ) {
+                frame.events.push_back ( buffer->events[i % LE_PROFILE_BUFFER_SIZE] );
+            }
+            buffer->tail.store ( head, memory_order_release );
+        }
+    }
+    frameStart = now;
+
+    double ms = ( frame.end - frame.start ) * 1000.0 / SDL_GetPerformanceFrequency();
+    if ( autoExportMs > 0 && ms > autoExportMs ) {
+        writeTrace ( autoExportPrefix + to_string ( frame.number ) + ".json", { frame } );
+    }
+
+    history.push_back ( std::move ( frame ) );
+    while ( history.size() > historyFrames ) history.pop_front();
+}
+
+void LE_Profiler::setAutoExport ( double thresholdMs, const std::string& prefix ) {
+    autoExportMs = thresholdMs;
+    autoExportPrefix = prefix;
+}
+
+Uint64 LE_Profiler::getDropped () {
+    lock_guard<std::mutex> lock ( mutex );
+    Uint64 dropped = 0;
+    for ( ThreadBuffer* buffer : buffers ) dropped += buffer->dropped.load();
+    return dropped;
+}
+
+bool LE_Profiler::exportTrace ( const std::string& filePath ) {
+    return writeTrace ( filePath, history );
+}
+
+static void writeJsonString ( ofstream& file, const char* text ) {
+    file << '"';
+    for ( const char* c = text; *c != '\0'; c++ ) {
+        if ( *c == '"' || *c == '\\' ) file << '\\' << *c;
+        else if ( (unsigned char)*c < 0x20 ) file << ' ';
+        else file << *c;
+    }
+    file << '"';
+}
+
+bool LE_Profiler::writeTrace ( const std::string& filePath, const std::deque<Frame>& frames ) {
+    ofstream file ( filePath );
+    if ( !file ) {
+        cerr << "Could not write the trace file " << filePath << endl;
+        return false;
+    }
+
+    double usPerTick = 1000000.0 / SDL_GetPerformanceFrequency();
+    file.precision ( 3 );
+    file << fixed << "{\"traceEvents\":[";
+
+    bool first = true;
+    {
+        lock_guard<std::mutex> lock ( mutex );
+        for ( ThreadBuffer* buffer : buffers ) {
+            file << ( first ? "\n" : ",\n" );
+            file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->thread
+                 << ",\"args\":{\"name\":";
+            writeJsonString ( file, buffer->name.c_str() );
+            file << "}}";
+            first = false;
+        }
+    }
+
+    for ( const Frame& frame : frames ) {
+        for ( const LE_ProfileEvent& event : frame.events ) {
+            file << ( first ? "\n" : ",\n" ) << "{\"name\":";
+            writeJsonString ( file, event.name );
+            file << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread
+                 << ",\"ts\":" << ( event.start - origin ) * usPerTick
+                 << ",\"dur\":" << ( event.end - event.start ) * usPerTick << "}";
+            first = false;
+        }
+    }
+
+    file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    return (bool)file;
+}
@@ -3,17 +3,31 @@
 
 #include <string>
 #include <map>
+#include <cmath>
 #include <vector>
 #include "lambda_TextureManager.h"
 #include "lambda_group_base.h"
 #include "lambda_events.h"
+#include "lambda_SlotMap.h"
+
+class LE_ObjectPool;
 
     /**
      * @brief groups a tile and a window Id
+     *
+     * The tile handle is resolved when the frame is created, so rendering
+     * a frame doesn't look up the tile by id.
      * */
     typedef struct LE_Frame {
         std::string tileId;
         Uint32 windowId;
+        LE_TileHandle handle;
+
+        LE_Frame (): windowId(0), handle(LE_INVALID_TILE_HANDLE) {}
+
+        LE_Frame ( std::string _tileId, Uint32 _windowId ):
+            tileId(_tileId), windowId(_windowId),
+            handle(LE_TEXTURE->resolveTile(_windowId, _tileId)) {}
     } LE_Frame;
 
     /**
@@ -38,6 +52,36 @@
             bool flipv;
             bool fliph;
 
+            /**
+             * @brief draw order when the render queue is enabled
+             *
+             * Objects on lower layers are drawn first, z orders objects
+             * inside a layer.
+             *
+             * @see LE_TextureManager::enableRenderQueue
+             * */
+            int layer;
+            int z;
+
+            /**
+             * @brief when true, x and y are relative to the camera viewport
+             * instead of world coordinates, for HUDs
+             *
+             * @see LE_TextureManager::addCamera
+             * */
+            bool screenSpace;
+
+            /**
+             * @brief id of the LE_GameState cached layer the object is
+             * drawn into, empty to draw it every frame
+             *
+             * Set it in setup, the layer is drawn again whenever the
+             * object moves or changes frame.
+             *
+             * @see LE_GameState::addCachedLayer
+             * */
+            std::string cacheLayer;
+
             /*
              * @brief Object ID, this is defined when the object is
              * registered to a LE_State
@@ -69,6 +113,81 @@
              * to frames memeber implementation
              * */
             std::string currentFrame;
+
+            /**
+             * @brief x, y and angle to draw the object at
+             *
+             * With a fixed timestep, interpolated between the previous and
+             * the last update by LE_Game::getAlpha, otherwise x, y and
+             * angle. Use them in custom renders to draw motion smoothly.
+             *
+             * Objects in a cached layer, or drawn with dirty tracking on,
+             * aren't interpolated since they are only drawn when they change.
+             *
+             * @see LE_Game::fixTimestep
+             * */
+            double interpX ();
+            double interpY ();
+            double interpAngle ();
+
+        private:
+            /**
+             * @brief handle of the object in its LE_GameState
+             * */
+            LE_ObjectHandle handle;
+
+            /**
+             * @brief pool the object was spawned from, nullptr if it was
+             * created with new
+             *
+             * @see LE_GameState::spawn
+             * */
+            LE_ObjectPool* pool;
+
+            /**
+             * @brief position before the last update, stored by LE_GameState
+             * when the timestep is fixed
+             * */
+            double prevX, prevY, prevAngle;
+
+            /**
+             * @brief Store the current position as the previous one
+             * */
+            void storePrevious () {
+                prevX = x;
+                prevY = y;
+                prevAngle = angle;
+            }
+
+            /**
+             * @brief returns true if the object is drawn between updates
+             * */
+            bool interpolated ( double alpha );
+
+            /**
+             * @brief draw members when the object was last checked for changes
+             *
+             * @see LE_TextureManager::setDirtyTracking
+             * */
+            typedef struct DrawState {
+                double x, y, h, w, angle;
+                bool scale, flipv, fliph;
+                int layer, z;
+                std::string frame;
+            } DrawState;
+
+            DrawState drawn;
+
+            /**
+             * @brief Mark the windows the object is drawn into as dirty if
+             * any draw member changed since the last check
+             *
+             * Called by LE_GameState after updating the object
+             *
+             * @return true if any draw member changed
+             * */
+            bool checkDrawState ();
+
         public:
 
             /**
@@ -163,6 +282,13 @@
              * */
             void disableGroup ( std::string groupId );
 
+            /**
+             * @brief handle of the object in the state it was added to
+             *
+             * @see LE_GameState::getObject
+             * */
+            LE_ObjectHandle getHandle () { return handle; }
+
             /**
              *  @brief destroys object in next frame
              * */
@@ -193,6 +319,27 @@
              * */
             virtual void update () {}
 
+            /**
+             * @brief Redraw the window of the current frame on the next frame
+             *
+             * Changes to the members drawn by the default render are found
+             * automatically, call this when a custom render changes.
+             * Objects in a cached layer should call
+             * LE_GameState::invalidateCachedLayer instead.
+             * Marks every window dirty if there is no current frame.
+             *
+             * @see LE_TextureManager::setDirtyTracking
+             * */
+            void markDirty ();
+
+            /**
+             * @brief Draw the object at its current position until the next update
+             *
+             * Call it after teleporting the object, so it doesn't slide
+             * from where it was when the timestep is fixed
+             * */
+            void resetInterpolation () { storePrevious(); }
+
             /**
              * @brief render game object into the window
              *
@@ -204,8 +351,9 @@
                 auto it = frames.find( currentFrame );
                 if ( it == frames.end() ) return;
 
-                LE_TEXTURE->draw ( it->second.windowId, it->second.tileId,
-                       x, y, h, w, scale, flipv, fliph, angle );
+                LE_TEXTURE->draw ( it->second.handle,
+                       (int)std::lround ( interpX() ), (int)std::lround ( interpY() ),
+                       h, w, scale, flipv, fliph, interpAngle(), layer, z, screenSpace );
             }
     };
 
@@ -1,5 +1,7 @@
 #include "lambda_GameObject.h"
 #include "lambda_FSM.h"
+#include "lambda_Game.h"
+#include <cmath>
 
 LE_GameObject::LE_GameObject()
     : x(0), y(0), h(1), w(1),
@@ -7,8 +9,64 @@ LE_GameObject::LE_GameObject()
       scale(true),
       flipv(false),
       fliph(false),
-      destroy_me(false)
-{}
+      layer(0), z(0),
+      screenSpace(false),
+      destroy_me(false),
+      pool(nullptr),
+      prevX(0), prevY(0), prevAngle(0)
+{
+    drawn = { x, y, h, w, angle, scale, flipv, fliph, layer, z, currentFrame };
+}
+
+bool LE_GameObject::checkDrawState () {
+    if ( drawn.x == x && drawn.y == y && drawn.h == h && drawn.w == w &&
+         drawn.angle == angle && drawn.scale == scale &&
+         drawn.flipv == flipv && drawn.fliph == fliph &&
+         drawn.layer == layer && drawn.z == z && drawn.frame == currentFrame ) {
+        return false;
+    }
+
+    // The previous frame may be in another window
+    if ( drawn.frame != currentFrame ) {
+        auto it = frames.find ( drawn.frame );
+        if ( it != frames.end() ) LE_TEXTURE->markDirty ( it->second.windowId );
+    }
+    markDirty();
+
+    drawn = { x, y, h, w, angle, scale, flipv, fliph, layer, z, currentFrame };
+    return true;
+}
+
+bool LE_GameObject::interpolated ( double alpha ) {
+    return alpha < 1 && cacheLayer.empty() && !LE_TEXTURE->isDirtyTracking();
+}
+
+double LE_GameObject::interpX () {
+    double alpha = LE_GAME->getAlpha();
+    if ( !interpolated ( alpha ) ) return x;
+    return prevX + ( x - prevX ) * alpha;
+}
+
+double LE_GameObject::interpY () {
+    double alpha = LE_GAME->getAlpha();
+    if ( !interpolated ( alpha ) ) return y;
+    return prevY + ( y - prevY ) * alpha;
+}
+
+double LE_GameObject::interpAngle () {
+    double alpha = LE_GAME->getAlpha();
+    if ( !interpolated ( alpha ) ) return angle;
+
+    // Turn the shortest way, 350 to 10 goes through 0
+    double diff = std::remainder ( angle - prevAngle, 360.0 );
+    return prevAngle + diff * alpha;
+}
+
+void LE_GameObject::markDirty () {
+    auto it = frames.find ( currentFrame );
+    if ( it != frames.end() ) LE_TEXTURE->markDirty ( it->second.windowId );
+    else LE_TEXTURE->markAllDirty();
+}
 
 void LE_GameObject::addEventHandler ( std::string name, Callback cb ) {
     LE_EVENTS->registerCallback(this->id + name, cb, this->id);
@@ -3,10 +3,13 @@
 #include <iostream>
 #include <vector>
 #include <map>
+#include <string>
 
 #ifndef _LAMBDA_INPUT_HANDLER_H_
 #define _LAMBDA_INPUT_HANDLER_H_
 
+    #include "lambda_InputLog.h"
+
     /**
      * @brief shortcut for getting LE_InputHandler::the_instance ptr
      * */
@@ -85,6 +88,25 @@
              * @brief saves mouse state
              * */
             MouseInput mouse;
+
+            /**
+             * @brief log being written, nullptr while not recording
+             * */
+            LE_InputLog* recording;
+
+            /**
+             * @brief log being replayed, nullptr while not replaying
+             * */
+            LE_InputLog* replaying;
+
+            /** @brief stop the game at the end of the replay */
+            bool exitAtReplayEnd;
+
+            /** @brief a quit event was received on this frame */
+            bool quitRequested;
+
+            /** @brief frame time of the frame being replayed */
+            double replayTime;
         public:
             /**
              * @brief returns a ptr to the class instance
@@ -161,8 +183,61 @@
 
             /**
              * @brief Poll SDL events
+             *
+             * While replaying, input events are ignored and the state of
+             * the next recorded frame is loaded instead
              * */
             void update();
+
+            /**
+             * @brief Record the input state of every frame into a file
+             *
+             * Keys, mouse, quit events and frame times are logged so the
+             * session can be replayed, see LE_InputHandler::startReplay.
+             *
+             * @param filePath
+             * @return false if the file couldn't be created
+             * */
+            bool startRecording ( std::string filePath );
+
+            /**
+             * @brief Stop recording and close the log
+             * */
+            void stopRecording ();
+
+            /**
+             * @brief Replay a recorded session instead of the live input
+             *
+             * Every frame gets the recorded input and frame time, so the
+             * game runs the same way as when it was recorded, as long as
+             * the game logic only depends on them. Window events and
+             * quitting from the window still work.
+             *
+             * @param filePath
+             * @param exitAtEnd call LE_Game::exit once the replay ends
+             * @return false if the file isn't an input log
+             * */
+            bool startReplay ( std::string filePath, bool exitAtEnd = true );
+
+            /**
+             * @brief Go back to live input
+             * */
+            void stopReplay ();
+
+            bool isRecording () { return recording != nullptr; }
+
+            bool isReplaying () { return replaying != nullptr; }
+
+            /**
+             * @brief Record or replay the frame time of the current frame
+             *
+             * Called by LE_Game after LE_InputHandler::update, with the time the frame
+             * simulates: written to the log when recording, replaced by the
+             * recorded one when replaying.
+             *
+             * @param frameTime in milliseconds
+             * */
+            void logFrame ( double* frameTime );
             void clean();
     };
 
@@ -0,0 +1,96 @@
+#ifndef _LAMBDA_INPUT_LOG_H_
+#define _LAMBDA_INPUT_LOG_H_
+
+#include <SDL2/SDL.h>
+#include <array>
+#include <fstream>
+#include <string>
+#include <vector>
+
+enum class keyState;
+struct MouseInput;
+
+/**
+ * @brief Binary log of the input state of each frame
+ *
+ * Each frame stores a flags byte, the frame time as a double, the keys
+ * that changed since the previous frame as (scancode, state) pairs and
+ * the mouse state when it changed, so idle frames take 9 bytes.
+ *
+ * Files are written in the byte order of the machine recording them.
+ *
+ * @see LE_InputHandler::startRecording
+ * */
+class LE_InputLog {
+    private:
+        bool writing;
+
+        std::ofstream out;
+
+        /** @brief whole file when reading, parsed frame by frame */
+        std::vector<char> data;
+        size_t cursor;
+
+        /** @brief state of the last frame written or read */
+        std::array<Uint8, SDL_NUM_SCANCODES> lastKeys;
+        std::vector<char> lastMouse;
+
+        int frames;
+
+        void put ( const void* value, size_t size );
+        bool get ( void* value, size_t size );
+
+    public:
+        LE_InputLog ();
+
+        ~LE_InputLog () { close(); }
+
+        /**
+         * @brief Create a log file to write frames into
+         *
+         * @return false if the file couldn't be created
+         * */
+        bool openWrite ( const std::string& filePath );
+
+        /**
+         * @brief Load a log file to read frames from
+         *
+         * @return false if the file couldn't be read or isn't an input log
+         * */
+        bool openRead ( const std::string& filePath );
+
+        /**
+         * @brief Flush and close the file being written
+         * */
+        void close ();
+
+        /**
+         * @brief Append a frame
+         *
+         * @param keys state of every key
+         * @param mouse
+         * @param quit true if the game was asked to quit on this frame
+         * @param frameTime time simulated on this frame in milliseconds
+         * */
+        void writeFrame ( const std::array<keyState, SDL_NUM_SCANCODES>& keys,
+                const MouseInput& mouse, bool quit, double frameTime );
+
+        /**
+         * @brief Read the next frame
+         *
+         * Overwrites keys and mouse with the recorded state, releasedKeys
+         * gets the keys in released state.
+         *
+         * @return false at the end of the log, or if it is truncated
+         * */
+        bool readFrame ( std::array<keyState, SDL_NUM_SCANCODES>& keys,
+                std::vector<SDL_Scancode>& releasedKeys,
+                MouseInput& mouse, bool* quit, double* frameTime );
+
+        /**
+         * @brief Number of frames written or read so far
+         * */
+        int getFrames () { return frames; }
+};
+
+#endif
@@ -1,5 +1,6 @@
 #include "lambda_InputHandler.h"
 #include "lambda_Game.h"
+#include "lambda_TextureManager.h"
 #include <iostream>
 
 LE_InputHandler* LE_InputHandler::the_instance;
@@ -9,7 +10,12 @@ LE_InputHandler::LE_InputHandler()
       is_joysticks_initialized(false),
       keys{},
       releasedKeys(),
-      mouse{}
+      mouse{},
+      recording(nullptr),
+      replaying(nullptr),
+      exitAtReplayEnd(true),
+      quitRequested(false),
+      replayTime(0)
 {
     mouse.left = keyState::idle;
     mouse.middle = keyState::idle;
@@ -57,15 +63,69 @@ void LE_InputHandler::clean() {
             SDL_JoystickClose(joysticks[i]);
         }
     }
+    stopRecording();
+    stopReplay();
+}
+
+bool LE_InputHandler::startRecording ( std::string filePath ) {
+    stopRecording();
+    recording = new LE_InputLog();
+    if ( !recording->openWrite ( filePath ) ) {
+        stopRecording();
+        return false;
+    }
+    return true;
+}
+
+void LE_InputHandler::stopRecording () {
+    if ( recording != nullptr ) {
+        delete recording;
+        recording = nullptr;
+    }
+}
+
+bool LE_InputHandler::startReplay ( std::string filePath, bool exitAtEnd ) {
+    stopReplay();
+    replaying = new LE_InputLog();
+    if ( !replaying->openRead ( filePath ) ) {
+        stopReplay();
+        return false;
+    }
+    exitAtReplayEnd = exitAtEnd;
+    return true;
+}
+
+void LE_InputHandler::stopReplay () {
+    if ( replaying != nullptr ) {
+        delete replaying;
+        replaying = nullptr;
+    }
+}
+
+void LE_InputHandler::logFrame ( double* frameTime ) {
+    if ( replaying != nullptr ) {
+        *frameTime = replayTime;
+    } else if ( recording != nullptr ) {
+        recording->writeFrame ( keys, mouse, quitRequested, *frameTime );
+    }
+    quitRequested = false;
 }
 
 void LE_InputHandler::update() {
     SDL_Event event;
 
     while (SDL_PollEvent(&event)) {
+        // Replays bring their own input
+        if ( replaying != nullptr && event.type != SDL_QUIT &&
+             event.type != SDL_WINDOWEVENT && event.type != SDL_RENDER_TARGETS_RESET &&
+             event.type != SDL_RENDER_DEVICE_RESET ) {
+            continue;
+        }
+
         switch (event.type)
         {
             case SDL_QUIT:
+                quitRequested = true;
                 LE_Game::Instance()->exit();
                 break;
 
@@ -132,8 +192,39 @@ void LE_InputHandler::update() {
                 mouse.yrel = event.motion.yrel;
                 mouse.windowId = event.motion.windowID;
                 break;
+
+            // Window contents must be drawn again, even if nothing changed
+            case SDL_WINDOWEVENT:
+                switch ( event.window.event ) {
+                    case SDL_WINDOWEVENT_SHOWN:
+                    case SDL_WINDOWEVENT_EXPOSED:
+                    case SDL_WINDOWEVENT_RESIZED:
+                    case SDL_WINDOWEVENT_SIZE_CHANGED:
+                    case SDL_WINDOWEVENT_RESTORED:
+                    case SDL_WINDOWEVENT_MAXIMIZED:
+                        LE_TEXTURE->markDirty ( event.window.windowID );
+                        break;
+                }
+                break;
+            // Render targets lost their contents
+            case SDL_RENDER_TARGETS_RESET:
+            case SDL_RENDER_DEVICE_RESET:
+                LE_TEXTURE->invalidateCachedLayers();
+                break;
             // TODO: add game controllers and gather joystick info
 
         }
     }
+
+    if ( replaying != nullptr ) {
+        bool quit;
+        if ( replaying->readFrame ( keys, releasedKeys, mouse, &quit, &replayTime ) ) {
+            if ( quit ) LE_Game::Instance()->exit();
+        } else {
+            std::cout << "Replay finished after " << replaying->getFrames()
+                << " frames" << std::endl;
+            stopReplay();
+            if ( exitAtReplayEnd ) LE_Game::Instance()->exit();
+        }
+    }
 }
@@ -0,0 +1,195 @@
+#include "lambda_InputLog.h"
+#include "lambda_InputHandler.h"
+#include <cstring>
+#include <iostream>
+
+#define LE_INPUT_LOG_MAGIC "LEIN"
+#define LE_INPUT_LOG_VERSION 1
+
+#define LE_INPUT_LOG_QUIT  0x01
+#define LE_INPUT_LOG_KEYS  0x02
+#define LE_INPUT_LOG_MOUSE 0x04
+
+/** @brief size of a serialized MouseInput */
+#define LE_INPUT_LOG_MOUSE_SIZE 32
+
+static void packMouse ( const MouseInput& mouse, char* buffer ) {
+    Uint8 buttons[3] = { (Uint8)mouse.left, (Uint8)mouse.middle, (Uint8)mouse.right };
+    Sint32 position[4] = { mouse.xrel, mouse.yrel, mouse.xabs, mouse.yabs };
+    float scroll[2] = { mouse.scrollx, mouse.scrolly };
+    Uint8 moved = mouse.was_moved;
+
+    memcpy ( buffer, &mouse.windowId, 4 );
+    memcpy ( buffer + 4, buttons, 3 );
+    memcpy ( buffer + 7, position, 16 );
+    memcpy ( buffer + 23, scroll, 8 );
+    memcpy ( buffer + 31, &moved, 1 );
+}
+
+static void unpackMouse ( const char* buffer, MouseInput& mouse ) {
+    Uint8 buttons[3];
+    Sint32 position[4];
+    float scroll[2];
+    Uint8 moved;
+
+    memcpy ( &mouse.windowId, buffer, 4 );
+    memcpy ( buttons, buffer + 4, 3 );
+    memcpy ( position, buffer + 7, 16 );
+    memcpy ( scroll, buffer + 23, 8 );
+    memcpy ( &moved, buffer + 31, 1 );
+
+    mouse.left = (keyState)buttons[0];
+    mouse.middle = (keyState)buttons[1];
+    mouse.right = (keyState)buttons[2];
+    mouse.xrel = position[0];
+    mouse.yrel = position[1];
+    mouse.xabs = position[2];
+    mouse.yabs = position[3];
+    mouse.scrollx = scroll[0];
+    mouse.scrolly = scroll[1];
+    mouse.was_moved = moved != 0;
+}
+
+LE_InputLog::LE_InputLog (): writing(false), cursor(0), frames(0) {
+    lastKeys.fill ( (Uint8)keyState::idle );
+}
+
+void LE_InputLog::put ( const void* value, size_t size ) {
+    out.write ( (const char*)value, size );
+}
+
+bool LE_InputLog::get ( void* value, size_t size ) {
+    if ( cursor + size > data.size() ) return false;
+    memcpy ( value, data.data() + cursor, size );
+    cursor += size;
+    return true;
+}
+
+bool LE_InputLog::openWrite ( const std::string& filePath ) {
+    close();
+    out.open ( filePath, std::ios::binary | std::ios::trunc );
+    if ( !out ) {
+        std::cerr << "Could not create input log " << filePath << std::endl;
+        return false;
+    }
+
+    Uint32 version = LE_INPUT_LOG_VERSION;
+    put ( LE_INPUT_LOG_MAGIC, 4 );
+    put ( &version, 4 );
+
+    writing = true;
+    frames = 0;
+    lastKeys.fill ( (Uint8)keyState::idle );
+    lastMouse.clear();
+    return true;
+}
+
+bool LE_InputLog::openRead ( const std::string& filePath ) {
+    close();
+    std::ifstream in ( filePath, std::ios::binary );
+    if ( !in ) {
+        std::cerr << "Could not open input log " << filePath << std::endl;
+        return false;
+    }
+    data.assign ( std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>() );
+    cursor = 0;
+
+    char magic[4];
+    Uint32 version;
+    if ( !get ( magic, 4 ) || memcmp ( magic, LE_INPUT_LOG_MAGIC, 4 ) != 0 ||
+         !get ( &version, 4 ) || version != LE_INPUT_LOG_VERSION ) {
+        std::cerr << filePath << " is not an input log" << std::endl;
+        data.clear();
+        return false;
+    }
+
+    frames = 0;
+    lastKeys.fill ( (Uint8)keyState::idle );
+    lastMouse.clear();
+    return true;
+}
+
+void LE_InputLog::close () {
+    if ( writing ) {
+        out.close();
+        writing = false;
+    }
+    data.clear();
+    cursor = 0;
+}
+
+void LE_InputLog::writeFrame ( const std::array<keyState, SDL_NUM_SCANCODES>& keys,
+        const MouseInput& mouse, bool quit, double frameTime ) {
+    if ( !writing ) return;
+
+    std::vector<Uint16> changed;
+    for ( int i = 0; i < SDL_NUM_SCANCODES; i++ ) {
+        if ( (Uint8)keys[i] != lastKeys[i] ) changed.push_back ( i );
+    }
+
+    char mouseData[LE_INPUT_LOG_MOUSE_SIZE];
+    packMouse ( mouse, mouseData );
+    bool mouseChanged = lastMouse.size() != LE_INPUT_LOG_MOUSE_SIZE ||
+        memcmp ( lastMouse.data(), mouseData, LE_INPUT_LOG_MOUSE_SIZE ) != 0;
+
+    Uint8 flags = ( quit ? LE_INPUT_LOG_QUIT : 0 ) |
+        ( changed.empty() ? 0 : LE_INPUT_LOG_KEYS ) |
+        ( mouseChanged ? LE_INPUT_LOG_MOUSE : 0 );
+    put ( &flags, 1 );
+    put ( &frameTime, 8 );
+
+    if ( !changed.empty() ) {
+        Uint16 count = changed.size();
+        put ( &count, 2 );
+        for ( Uint16 scancode : changed ) {
+            Uint8 state = (Uint8)keys[scancode];
+            put ( &scancode, 2 );
+            put ( &state, 1 );
+            lastKeys[scancode] = state;
+        }
+    }
+
+    if ( mouseChanged ) {
+        put ( mouseData, LE_INPUT_LOG_MOUSE_SIZE );
+        lastMouse.assign ( mouseData, mouseData + LE_INPUT_LOG_MOUSE_SIZE );
+    }
+
+    frames++;
+}
+
+bool LE_InputLog::readFrame ( std::array<keyState, SDL_NUM_SCANCODES>& keys,
+        std::vector<SDL_Scancode>& releasedKeys,
+        MouseInput& mouse, bool* quit, double* frameTime ) {
+    Uint8 flags;
+    if ( !get ( &flags, 1 ) || !get ( frameTime, 8 ) ) return false;
+    *quit = ( flags & LE_INPUT_LOG_QUIT ) != 0;
+
+    if ( flags & LE_INPUT_LOG_KEYS ) {
+        Uint16 count;
+        if ( !get ( &count, 2 ) ) return false;
+        for ( int i = 0; i < count; i++ ) {
+            Uint16 scancode;
+            Uint8 state;
+            if ( !get ( &scancode, 2 ) || !get ( &state, 1 ) ) return false;
+            if ( scancode >= SDL_NUM_SCANCODES ) return false;
+            lastKeys[scancode] = state;
+        }
+    }
+
+    if ( flags & LE_INPUT_LOG_MOUSE ) {
+        char mouseData[LE_INPUT_LOG_MOUSE_SIZE];
+        if ( !get ( mouseData, LE_INPUT_LOG_MOUSE_SIZE ) ) return false;
+        lastMouse.assign ( mouseData, mouseData + LE_INPUT_LOG_MOUSE_SIZE );
+    }
+
+    // The whole state is restored, in case the game changed it since
+    releasedKeys.clear();
+    for ( int i = 0; i < SDL_NUM_SCANCODES; i++ ) {
+        keys[i] = (keyState)lastKeys[i];
+        if ( keys[i] == keyState::released ) releasedKeys.push_back ( (SDL_Scancode)i );
+    }
+    if ( lastMouse.size() == LE_INPUT_LOG_MOUSE_SIZE ) unpackMouse ( lastMouse.data(), mouse );
+
+    frames++;
+    return true;
+}
@@ -15,11 +15,31 @@
     #include "lambda_many_to_many.h"
     #include "lambda_one_to_many.h"
     #include "lambda_cursor.h"
+    #include "lambda_Jobs.h"
+    #include "lambda_Profiler.h"
+    #include "lambda_ECS.h"
+    #include "lambda_ECSSprite.h"
 
 
-    inline bool LE_Init () {
+    /**
+     * @brief Initializes Lambda Engine
+     *
+     * @param headless use the SDL dummy video and audio drivers and
+     * create offscreen windows, to run without a display
+     * @return false if SDL could not be initialized
+     * */
+    inline bool LE_Init ( bool headless = false ) {
+        // Drivers are chosen when SDL is initialized by LE_TEXTURE
+        if ( headless ) {
+            SDL_setenv ( "SDL_VIDEODRIVER", "dummy", 1 );
+            SDL_setenv ( "SDL_AUDIODRIVER", "dummy", 1 );
+        }
+
         // Create singletons
         if ( !LE_TEXTURE->EverythingWasInit() ) return false;
+        LE_PROFILER;
+        LE_JOBS;
+        LE_TEXTURE->setHeadless ( headless );
         LE_GAME;
         LE_FSM;
         LE_INPUT;
@@ -32,7 +52,10 @@
     }
 
     inline void LE_Quit () {
-        // Destroy singletons
+        // Destroy singletons, workers first since jobs may use the others
+        QUIT_LE_JOBS;
+        // The overlay font and textures need LE_TEXT and LE_TEXTURE
+        LE_GAME->disablePerfOverlay();
         QUIT_LE_TEXT;
         QUIT_LE_AUDIO;
         QUIT_LE_GAME;
@@ -41,6 +64,8 @@
         QUIT_LE_TILEMAP;
         QUIT_LE_TEXTURE;
         QUIT_LE_EVENTS;
+        // Last, texture loader threads record scopes until they are joined
+        QUIT_LE_PROFILER;
     }
 
 #endif
@@ -197,6 +197,30 @@
                    std::string tileId_prefix, int maxWidth, Uint8 r, Uint8 g, Uint8 b,
                    Uint8 a, int* lineskip, int* lineheight );
 
+            /**
+             * @brief Renders a line of text into a new texture
+             *
+             * Unlike LE_TextManager::createTexture, the texture isn't added
+             * to the window, so replacing it often doesn't invalidate tile
+             * handles. The caller draws it with the window renderer and
+             * destroys it.
+             *
+             * @param text text to render, in a single line
+             * @param windowId
+             * @param fontId
+             * @param r red color value
+             * @param g green color value
+             * @param b blue color value
+             * @param a alpha color value
+             * @param h return the texture height
+             * @param w return the texture width
+             *
+             * @return nullptr if the text could not be rendered
+             * */
+            SDL_Texture* renderText ( const std::string& text, Uint32 windowId,
+                    const std::string& fontId, Uint8 r, Uint8 g, Uint8 b, Uint8 a,
+                    int* h, int* w );
+
             /**
              * @brief deallocates memory allocated from this object
              * */
@@ -96,3 +96,32 @@ int LE_TextManager::createTexture
          return lines.size();
 }
 
+
+SDL_Texture* LE_TextManager::renderText ( const std::string& text, Uint32 windowId,
+        const std::string& fontId, Uint8 r, Uint8 g, Uint8 b, Uint8 a,
+        int* h, int* w ) {
+    auto it = fonts.find ( fontId );
+    if ( it == fonts.end() ) {
+        std::cerr << "Error rendering text: "
+            << "Font ID: " << fontId << " Doesn't exist" << std::endl;
+        return nullptr;
+    }
+
+    SDL_Renderer* renderer = LE_TEXTURE->getRenderer ( windowId );
+    if ( renderer == nullptr ) return nullptr;
+
+    SDL_Color fg = {r, g, b, a};
+    SDL_Surface* surface = TTF_RenderUTF8_Solid ( it->second->ttf_font, text.c_str(), fg );
+    if ( surface == nullptr ) {
+        std::cerr << "Error rendering text: " << TTF_GetError() << std::endl;
+        return nullptr;
+    }
+
+    SDL_Texture* texture = SDL_CreateTextureFromSurface ( renderer, surface );
+    SDL_FreeSurface ( surface );
+    if ( texture == nullptr ) return nullptr;
+
+    SDL_SetTextureBlendMode ( texture, SDL_BLENDMODE_BLEND );
+    SDL_QueryTexture ( texture, NULL, NULL, w, h );
+    return texture;
+}
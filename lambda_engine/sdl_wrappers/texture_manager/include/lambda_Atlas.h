@@ -0,0 +1,156 @@
+#ifndef _LAMBDA_ENGINE_ATLAS_H_
+#define _LAMBDA_ENGINE_ATLAS_H_
+
+    #include <SDL2/SDL.h>
+    #include <vector>
+    #include <map>
+    #include <string>
+
+    /**
+     * @brief Skyline bottom-left rectangle packer
+     *
+     * Keeps the top outline (skyline) of the rectangles packed so far
+     * and places every new rectangle where its top edge ends lowest.
+     * */
+    class LE_AtlasPacker
+    {
+        private:
+            /**
+             * @brief horizontal segment of the skyline
+             * */
+            typedef struct SkylineNode {
+                int x;
+                int y;
+                int w;
+            } SkylineNode;
+
+            int width;
+            int height;
+
+            /** @brief segments ordered by x, covering the whole width */
+            std::vector<SkylineNode> skyline;
+
+            /**
+             * @brief y where a w wide rectangle fits starting at skyline[idx]
+             *
+             * @return -1 if it doesn't fit
+             * */
+            int fitAt ( int idx, int w, int h );
+
+        public:
+            /**
+             * @brief Class constructor
+             *
+             * @param m_width page width in pixels
+             * @param m_height page height in pixels
+             * */
+            LE_AtlasPacker ( int m_width, int m_height );
+
+            /**
+             * @brief Find room for a rectangle
+             *
+             * @param w rectangle width
+             * @param h rectangle height
+             * @param x where to save the rectangle x coord
+             * @param y where to save the rectangle y coord
+             * @return false if the page has no room for it
+             * */
+            bool insert ( int w, int h, int* x, int* y );
+    };
+
+    /**
+     * @brief Packs the images and tiles of a TILESETS file into atlas pages
+     *
+     * Used by LE_TextureManager::loadFromXmlFile when atlas mode is on:
+     * images are decoded, every tile is trimmed of its transparent borders
+     * and packed into pages of LE_TextureManager::getAtlasPageSize pixels,
+     * then each page becomes a texture with id "<group>#<page number>"
+     * and the tiles are created pointing to it, keeping their ids.
+     * */
+    class LE_AtlasBuilder
+    {
+        private:
+            /**
+             * @brief image waiting to be packed
+             * */
+            typedef struct AtlasImage {
+                std::string filePath;
+                std::string group;
+                SDL_Surface* surface;
+            } AtlasImage;
+
+            /**
+             * @brief tile waiting to be packed
+             *
+             * When full is true the tile covers the whole image.
+             * */
+            typedef struct AtlasTile {
+                std::string tileId;
+                std::string textureId;
+                SDL_Rect rect;
+                bool full;
+            } AtlasTile;
+
+            /**
+             * @brief images by texture Id
+             * */
+            std::map<std::string, AtlasImage> images;
+
+            std::vector<AtlasTile> tiles;
+
+            /**
+             * @brief pixels left between packed tiles to avoid filtering bleed
+             * */
+            int padding;
+
+            /**
+             * @brief Packs the tiles of one group and creates its pages and tiles
+             * */
+            void buildGroup ( Uint32 windowId, const std::string& group,
+                    const std::vector<AtlasTile*>& groupTiles, int pageSize );
+
+        public:
+            LE_AtlasBuilder (): padding(1) {}
+
+            ~LE_AtlasBuilder ();
+
+            /**
+             * @brief register an image to be packed
+             *
+             * @param textureId id the texture had in the TILESETS file
+             * @param filePath image path
+             * @param group atlas group, images of the same group share pages
+             * */
+            void addImage ( std::string textureId, std::string filePath, std::string group );
+
+            /**
+             * @brief returns true if textureId was registered with addImage
+             * */
+            bool hasImage ( const std::string& textureId ) {
+                return images.find( textureId ) != images.end();
+            }
+
+            /**
+             * @brief register a tile to be packed
+             *
+             * if h or w are 0, the tile covers the whole image
+             *
+             * @param textureId
+             * @param tileId
+             * @param x tile x coord in the image
+             * @param y tile y coord in the image
+             * @param h tile height
+             * @param w tile width
+             * */
+            void addTile ( std::string textureId, std::string tileId,
+                    int x = 0, int y = 0, int h = 0, int w = 0 );
+
+            /**
+             * @brief Decode, trim, pack and upload everything registered
+             *
+             * @param windowId window the pages and tiles are created for
+             * */
+            void build ( Uint32 windowId );
+    };
+
+#endif
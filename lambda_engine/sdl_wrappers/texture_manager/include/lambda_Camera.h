@@ -0,0 +1,128 @@
+#ifndef _LAMBDA_ENGINE_CAMERA_H_
+#define _LAMBDA_ENGINE_CAMERA_H_
+
+    #include <SDL2/SDL.h>
+    #include <string>
+
+    /**
+     * @brief View of a window into the game world
+     *
+     * While a camera is in use, draws are made in world coordinates and
+     * moved, scaled and rotated into the camera viewport by the texture
+     * manager, so scrolling a scene only means moving its camera.
+     *
+     * Windows can have several cameras, each drawing the whole scene into
+     * its own viewport (split screen, minimaps...).
+     *
+     * @see LE_TextureManager::addCamera
+     * */
+    class LE_Camera
+    {
+        friend class LE_TextureManager;
+
+        private:
+            std::string id;
+
+            /**
+             * @brief rotation and viewport size of the last frame drawn,
+             * updated by LE_TextureManager::beginCameraPass
+             * */
+            double cosAngle;
+            double sinAngle;
+            int viewW;
+            int viewH;
+
+            /**
+             * @brief Compute the rotation for the current angle
+             *
+             * @param w viewport width in pixels
+             * @param h viewport height in pixels
+             * */
+            void update ( int w, int h );
+
+            /**
+             * @brief camera state when it was last checked for changes
+             *
+             * @see LE_TextureManager::setDirtyTracking
+             * */
+            double drawnX, drawnY, drawnZoom, drawnAngle;
+            SDL_Rect drawnViewport;
+
+            /**
+             * @brief returns true if the camera moved since the last call
+             * */
+            bool changed ();
+
+        public:
+            /**
+             * @brief world position shown at the center of the viewport
+             * */
+            double x;
+            double y;
+
+            /**
+             * @brief world scale, 2 shows everything twice as big
+             * */
+            double zoom;
+
+            /**
+             * @brief clockwise rotation of the camera in degrees, the world
+             * is shown rotated the other way around the viewport center
+             * */
+            double angle;
+
+            /**
+             * @brief round draw positions to whole pixels
+             *
+             * Avoids seams between tiles and shimmering when scrolling
+             * at fractional positions
+             * */
+            bool pixelSnap;
+
+            /**
+             * @brief area of the window the camera draws into, a zero
+             * width or height uses the whole window
+             * */
+            SDL_Rect viewport;
+
+            /**
+             * @brief Class constructor
+             *
+             * @param cameraId
+             * */
+            LE_Camera ( std::string cameraId ): id(cameraId),
+                cosAngle(1), sinAngle(0), viewW(0), viewH(0),
+                drawnX(0), drawnY(0), drawnZoom(1), drawnAngle(0),
+                drawnViewport({ 0, 0, 0, 0 }),
+                x(0), y(0), zoom(1), angle(0), pixelSnap(true),
+                viewport({ 0, 0, 0, 0 }) {}
+
+            /**
+             * @brief camera id getter function
+             * */
+            const std::string& getId () { return id; }
+
+            /**
+             * @brief Convert world coordinates to viewport coordinates
+             *
+             * Uses the viewport size of the last frame drawn
+             * */
+            void toViewport ( double wx, double wy, double* vx, double* vy );
+
+            /**
+             * @brief Convert viewport coordinates to world coordinates
+             *
+             * Uses the viewport size of the last frame drawn. Useful to find
+             * what is under the mouse, after subtracting the viewport position.
+             * */
+            void toWorld ( double vx, double vy, double* wx, double* wy );
+
+            /**
+             * @brief Get the area of the world seen by the camera
+             *
+             * The smallest rectangle containing the rotated viewport
+             * */
+            SDL_Rect worldView ();
+    };
+
+#endif
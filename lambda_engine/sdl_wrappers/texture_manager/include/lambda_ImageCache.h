@@ -0,0 +1,90 @@
+#ifndef _LAMBDA_ENGINE_IMAGE_CACHE_H_
+#define _LAMBDA_ENGINE_IMAGE_CACHE_H_
+
+    #include <SDL2/SDL.h>
+    #include <map>
+    #include <string>
+
+    /**
+     * @brief Decoded images shared by every window, keyed by file path
+     *
+     * SDL textures belong to a single renderer, but the decoded image
+     * doesn't, so each image file is decoded once and kept here while any
+     * LE_Window references it. Windows create their own texture from the
+     * cached image the first time it is drawn.
+     * */
+    class LE_ImageCache
+    {
+        private:
+            /**
+             * @brief decoded image and how many textures use it
+             * */
+            typedef struct CachedImage {
+                SDL_Surface* surface;
+                int refs;
+            } CachedImage;
+
+            std::map<std::string, CachedImage> images;
+
+        public:
+            LE_ImageCache () {}
+
+            /**
+             * @brief Class destructor
+             *
+             * Frees every image, even if still referenced
+             * */
+            ~LE_ImageCache () { clear(); }
+
+            /**
+             * @brief Get an image, adding a reference to it
+             *
+             * If the image isn't cached it is decoded from filePath, unless
+             * decoded is provided, then the cache takes ownership of it.
+             * If the image is already cached, decoded is freed.
+             *
+             * @param filePath image path, used as key
+             * @param decoded image already decoded from filePath or nullptr
+             * @return nullptr if the image couldn't be decoded
+             * */
+            SDL_Surface* acquire ( const std::string& filePath, SDL_Surface* decoded = nullptr );
+
+            /**
+             * @brief Remove a reference, the image is freed with the last one
+             * */
+            void release ( const std::string& filePath );
+
+            /**
+             * @brief Get a cached image without adding a reference
+             *
+             * @return nullptr if it isn't cached
+             * */
+            SDL_Surface* get ( const std::string& filePath ) {
+                auto it = images.find ( filePath );
+                return it != images.end() ? it->second.surface : nullptr;
+            }
+
+            /**
+             * @brief returns true if the image is cached
+             * */
+            bool contains ( const std::string& filePath ) {
+                return images.find ( filePath ) != images.end();
+            }
+
+            /**
+             * @brief Number of cached images
+             * */
+            int count () { return images.size(); }
+
+            /**
+             * @brief Memory used by the cached pixels in bytes
+             * */
+            Uint64 bytes ();
+
+            /**
+             * @brief Free every image
+             * */
+            void clear ();
+    };
+
+#endif
@@ -0,0 +1,99 @@
+#ifndef _LAMBDA_ENGINE_RENDER_QUEUE_H_
+#define _LAMBDA_ENGINE_RENDER_QUEUE_H_
+
+    #include <SDL2/SDL.h>
+    #include <unordered_map>
+    #include <vector>
+    #include "lambda_SpriteBatch.h"
+
+    /**
+     * @brief Draw commands of a frame, sorted before being drawn
+     *
+     * Each command gets a 64 bit sort key made of, from most to least
+     * significant bits:
+     *
+     * | bits  | field                                           |
+     * |-------|-------------------------------------------------|
+     * | 16    | layer                                           |
+     * | 16    | z                                               |
+     * | 24    | texture, in order of first use since last clear |
+     * | 8     | blend mode                                      |
+     *
+     * Commands are sorted with a stable LSD radix sort, so lower layers
+     * are drawn first, then lower z inside a layer, and commands with the
+     * same layer and z are grouped by texture. Commands with the same key
+     * keep the order they were pushed in.
+     * */
+    class LE_RenderQueue
+    {
+        private:
+            /**
+             * @brief sort key and position in commands
+             * */
+            typedef struct Item {
+                Uint64 key;
+                Uint32 index;
+            } Item;
+
+            std::vector<LE_DrawCommand> commands;
+
+            /** @brief sorted after calling sort */
+            std::vector<Item> items;
+
+            /** @brief radix sort buffer, kept to avoid allocations */
+            std::vector<Item> scratch;
+
+            /** @brief sort id of each texture, by first use */
+            std::unordered_map<SDL_Texture*, Uint32> textureIds;
+
+        public:
+            LE_RenderQueue () {}
+
+            ~LE_RenderQueue () {}
+
+            /**
+             * @brief Build a sort key
+             *
+             * layer and z are clamped to 16 bit signed integers
+             * */
+            static Uint64 makeKey ( int layer, int z, Uint32 textureId, SDL_BlendMode blendMode );
+
+            /**
+             * @brief add a command to the queue
+             *
+             * @param cmd
+             * @param layer
+             * @param z order inside the layer
+             * */
+            void push ( const LE_DrawCommand& cmd, int layer, int z );
+
+            /**
+             * @brief Sort commands by key
+             * */
+            void sort ();
+
+            /**
+             * @brief Number of commands in the queue
+             * */
+            size_t size () { return items.size(); }
+
+            bool empty () { return items.empty(); }
+
+            /**
+             * @brief Get a command, in sorted order after calling sort
+             * */
+            const LE_DrawCommand& operator[] ( size_t i ) {
+                return commands[items[i].index];
+            }
+
+            /**
+             * @brief Remove every command
+             * */
+            void clear () {
+                commands.clear();
+                items.clear();
+                textureIds.clear();
+            }
+    };
+
+#endif
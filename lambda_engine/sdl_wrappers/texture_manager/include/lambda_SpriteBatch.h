@@ -0,0 +1,123 @@
+#ifndef _LAMBDA_ENGINE_SPRITE_BATCH_H_
+#define _LAMBDA_ENGINE_SPRITE_BATCH_H_
+
+    #include <SDL2/SDL.h>
+    #include <vector>
+
+    /**
+     * @brief Everything needed to draw a single sprite
+     *
+     * Built by LE_TextureManager::draw, then either copied to the renderer
+     * right away or appended to the window's LE_SpriteBatch.
+     * */
+    typedef struct LE_DrawCommand {
+        SDL_Texture* texture;
+        SDL_BlendMode blendMode;
+
+        /**
+         * @brief texture color and alpha modulation
+         *
+         * SDL_RenderGeometry ignores the texture modulation, so it is
+         * applied through the vertex colors instead.
+         * */
+        SDL_Color color;
+
+        /** @brief texture size, needed to compute texture coordinates */
+        int texW;
+        int texH;
+
+        SDL_Rect src;
+        SDL_FRect dst;
+
+        /** @brief rotation in degrees, clockwise around center */
+        double angle;
+
+        /** @brief rotation center, relative to dst */
+        SDL_FPoint center;
+
+        SDL_RendererFlip flip;
+    } LE_DrawCommand;
+
+    /**
+     * @brief Accumulates sprites sharing a texture into a single draw call
+     *
+     * Each LE_Window owns a sprite batch. Consecutive sprites drawn with
+     * the same texture and blend mode are stored as quads (rotation and
+     * flips are computed on the CPU) and sent to SDL with a single
+     * SDL_RenderGeometry call when the texture changes or the batch is
+     * flushed. Draw order is preserved.
+     *
+     * Requires SDL 2.0.18 or newer.
+     * */
+    class LE_SpriteBatch
+    {
+        private:
+            SDL_Renderer* renderer;
+
+            /** @brief texture of the quads waiting to be flushed */
+            SDL_Texture* texture;
+
+            /** @brief blend mode of the quads waiting to be flushed */
+            SDL_BlendMode blendMode;
+
+            /** @brief 4 vertices per quad */
+            std::vector<SDL_Vertex> vertices;
+
+            /**
+             * @brief 6 indices per quad
+             *
+             * Only grows, since indices are the same for every batch
+             * */
+            std::vector<int> indices;
+
+        public:
+            /**
+             * @brief Maximum number of quads sent on a single draw call
+             * */
+            static const int maxQuads = 16384;
+
+            /**
+             * @brief Class constructor
+             *
+             * @param ren renderer the batch draws into
+             * */
+            LE_SpriteBatch ( SDL_Renderer* ren ):
+                renderer(ren), texture(nullptr), blendMode(SDL_BLENDMODE_NONE) {}
+
+            ~LE_SpriteBatch () {}
+
+            /**
+             * @brief add a sprite to the batch
+             *
+             * If the sprite texture or blend mode doesn't match the batch,
+             * the batch is flushed first.
+             *
+             * @param cmd sprite to add
+             * @return number of draw calls issued (0 or 1)
+             * */
+            int push ( const LE_DrawCommand& cmd );
+
+            /**
+             * @brief Send pending quads to the renderer
+             *
+             * @return number of draw calls issued (0 or 1)
+             * */
+            int flush ();
+
+            /**
+             * @brief Drop pending quads without drawing them
+             *
+             * Used when the textures they reference are about to be destroyed.
+             * */
+            void discard () {
+                vertices.clear();
+                texture = nullptr;
+            }
+
+            /**
+             * @brief returns true if there are no quads waiting to be flushed
+             * */
+            bool empty () { return vertices.empty(); }
+    };
+
+#endif
@@ -0,0 +1,117 @@
+#ifndef _LAMBDA_ENGINE_TEXTURE_LOADER_H_
+#define _LAMBDA_ENGINE_TEXTURE_LOADER_H_
+
+    #include <SDL2/SDL.h>
+    #include <condition_variable>
+    #include <functional>
+    #include <mutex>
+    #include <thread>
+    #include <deque>
+    #include <vector>
+    #include <string>
+
+    /**
+     * @brief Called on the main thread when an asynchronous load finishes
+     *
+     * The parameter is false if anything failed to load.
+     * */
+    typedef std::function<void(bool)> LE_LoadCallback;
+
+    /**
+     * @brief Texture waiting to be decoded or uploaded
+     * */
+    typedef struct LE_LoadRequest {
+        Uint32 windowId;
+        std::string filePath;
+        std::string textureId;
+        LE_LoadCallback onDone;
+
+        /** @brief decoded image, nullptr until decoded or if decoding failed */
+        SDL_Surface* surface;
+
+        /** @brief decoding error message */
+        std::string error;
+    } LE_LoadRequest;
+
+    /**
+     * @brief Decodes images on worker threads
+     *
+     * Requests are decoded in the order they are pushed, and wait in a
+     * queue until the main thread pops them to create the textures, since
+     * SDL renderers can only be used from the thread that created them.
+     * */
+    class LE_TextureLoader
+    {
+        private:
+            std::vector<std::thread> workers;
+
+            std::mutex mutex;
+
+            /** @brief wakes workers up when there is work or when stopping */
+            std::condition_variable wake;
+
+            /** @brief requests waiting to be decoded */
+            std::deque<LE_LoadRequest*> pending;
+
+            /** @brief requests waiting to be uploaded */
+            std::deque<LE_LoadRequest*> decoded;
+
+            /** @brief requests pushed and not popped yet */
+            int inFlight;
+
+            bool stopping;
+
+            void workerLoop ();
+
+        public:
+            /**
+             * @brief Class constructor
+             *
+             * @param threads number of worker threads
+             * */
+            LE_TextureLoader ( int threads );
+
+            /**
+             * @brief Class destructor
+             *
+             * Waits for the images being decoded and drops every request
+             * left without calling its callback.
+             * */
+            ~LE_TextureLoader ();
+
+            /**
+             * @brief Queue an image to be decoded
+             *
+             * The loader takes ownership of req
+             * */
+            void push ( LE_LoadRequest* req );
+
+            /**
+             * @brief Queue a request that doesn't need decoding
+             *
+             * It is returned by pop with a nullptr surface, after the
+             * requests already decoded. The loader takes ownership of req
+             * */
+            void complete ( LE_LoadRequest* req );
+
+            /**
+             * @brief Get the next decoded request, doesn't block
+             *
+             * The caller takes ownership of the request and its surface.
+             *
+             * @return nullptr if nothing is ready yet
+             * */
+            LE_LoadRequest* pop ();
+
+            /**
+             * @brief Number of requests pushed and not popped yet
+             * */
+            int count ();
+
+            /**
+             * @brief Number of worker threads
+             * */
+            int threads () { return workers.size(); }
+    };
+
+#endif
@@ -5,9 +5,18 @@
     #include <SDL2/SDL_image.h>
     #include <SDL2/SDL_ttf.h>
     #include <vector>
+    #include <deque>
     #include <map>
+    #include <mutex>
     #include <string>
     #include <iostream>
+    #include <algorithm>
+    #include "lambda_SpriteBatch.h"
+    #include "lambda_RenderQueue.h"
+    #include "lambda_Camera.h"
+    #include "lambda_TextureLoader.h"
+    #include "lambda_ImageCache.h"
+    #include "lambda_Profiler.h"
 
     /**
      * @brief Shortcut to calling the texture manager instance
@@ -45,6 +54,26 @@
         mul =   SDL_BLENDMODE_MUL
     } LE_BlendMode;
 
+    /**
+     * @brief Compact reference to a tile of a specific window
+     *
+     * Obtained from \ref LE_TextureManager::resolveTile "LE_TextureManager::resolveTile()",
+     * a tile handle lets LE_TextureManager::draw skip the window, tile and texture
+     * lookups by id, which is what you want for anything drawn every frame.
+     *
+     * @code
+     * LE_TileHandle player = LE_TEXTURE->resolveTile( mainWindow, "player_idle" );
+     * // On every frame:
+     * LE_TEXTURE->draw( player, x, y );
+     * @endcode
+     * */
+    typedef Uint32 LE_TileHandle;
+
+    /**
+     * @brief Value used for handles that do not point to any tile
+     * */
+    #define LE_INVALID_TILE_HANDLE ((LE_TileHandle)0xFFFFFFFF)
+
     /**
      * @brief Stores tile location info
      *
@@ -55,6 +84,7 @@
     {
         friend class LE_Window;
         friend class LE_TextureManager;
+        friend class LE_AtlasBuilder;
 
         private:
             /**
@@ -90,6 +120,21 @@
             /** @brief width in pixels */
             int w;
 
+            /**
+             * @brief Transparent columns removed from the left of the tile
+             *
+             * Tiles packed into an atlas have their transparent borders trimmed,
+             * trim_x, trim_y, full_h and full_w keep the original tile frame so
+             * trimmed tiles are drawn exactly where the untrimmed ones would.
+             * */
+            int trim_x;
+            /** @brief Transparent rows removed from the top of the tile */
+            int trim_y;
+            /** @brief height in pixels before trimming */
+            int full_h;
+            /** @brief width in pixels before trimming */
+            int full_w;
+
         public:
             /**
              * @brief Class constructor
@@ -101,7 +146,8 @@
              * @param m_w width in pixels
              * */
             LE_Tile ( std::string m_textureId, int m_x, int m_y, int m_h, int m_w ):
-                      textureId(m_textureId), x(m_x), y(m_y), h(m_h), w(m_w) {}
+                      textureId(m_textureId), x(m_x), y(m_y), h(m_h), w(m_w),
+                      trim_x(0), trim_y(0), full_h(m_h), full_w(m_w) {}
             /**
              * @brief Class destructor
              * */
@@ -120,12 +166,90 @@
                          int* m_x = nullptr, int* m_y = nullptr,
                          int* m_h = nullptr, int* m_w = nullptr );
 
-            void set_x ( int m_x ) { x = m_x; }
-            void set_y ( int m_y ) { y = m_y; }
-            void set_h ( int m_h ) { h = m_h; }
-            void set_w ( int m_w ) { w = m_w; }
+            /*
+             * Setters invalidate tile handles, since those cache the
+             * tile source rect. Setting the size of a trimmed tile
+             * drops its trimming.
+             * */
+            void set_x ( int m_x );
+            void set_y ( int m_y );
+            void set_h ( int m_h );
+            void set_w ( int m_w );
     };
 
+    /**
+     * @brief Texture of a LE_Window
+     *
+     * Textures loaded from image files keep the path of their image in
+     * the LE_ImageCache, so they can be created on demand, and destroyed
+     * to stay under the window texture budget.
+     * */
+    typedef struct LE_TextureEntry {
+        /**
+         * @brief nullptr until first used or after being evicted,
+         * for textures loaded from images
+         * */
+        SDL_Texture* texture;
+
+        /**
+         * @brief image the texture is created from, in LE_ImageCache
+         *
+         * Empty for textures created by other means (render targets,
+         * LE_TextureManager::addTexture...)
+         * */
+        std::string filePath;
+
+        /**
+         * @brief true while the entry holds a reference to its image
+         * */
+        bool imageHeld;
+
+        /** @brief texture size, known even if the texture isn't created */
+        int w;
+        int h;
+
+        /** @brief texture memory in bytes, 0 while not created */
+        Uint64 bytes;
+
+        /**
+         * @brief last frame the texture was drawn
+         *
+         * @see LE_TextureManager::beginFrame
+         * */
+        Uint32 lastUsed;
+
+        /**
+         * @brief blend mode and color modulation saved on eviction,
+         * restored when the texture is created again
+         * */
+        bool restoreState;
+        SDL_BlendMode blendMode;
+        SDL_Color color;
+    } LE_TextureEntry;
+
+    /**
+     * @brief Draws rendered once into a target texture and reused every
+     * frame until invalidated
+     *
+     * @see LE_TextureManager::beginCachedLayer
+     * */
+    typedef struct LE_CachedLayer {
+        /** @brief target texture from the window pool, nullptr if never built */
+        SDL_Texture* texture;
+
+        /** @brief area covered, in window coordinates */
+        SDL_Rect area;
+
+        /** @brief false when the layer must be drawn again */
+        bool valid;
+
+        /**
+         * @brief true if the texture couldn't be created for this area,
+         * the draws of the layer go straight to the window
+         * */
+        bool direct;
+    } LE_CachedLayer;
+
     /**
      * @brief Class for grouping window-dependent elements
      *
@@ -136,7 +260,9 @@
      * it access to SDL functionality; a SDL_Renerer* member which can
      * only work for the window it was created; a SDL_Texture* mapping
      * to sort by ID all the textures created for that renderer (which
-     * can'y neither be used in a different one); and finally a mapping
+     * can'y neither be used in a different one, though textures loaded
+     * from the same image file share the decoded image through the
+     * LE_ImageCache); and finally a mapping
      * of LE_Tile* objects, which, as we stated in LE_Tile class,
      * can be used in several windows (if they both share textureId's and
      * probably also loaded the same textures for their own renderer)
@@ -151,6 +277,13 @@
              * */
             SDL_Window*                         sdl_window;
 
+            /**
+             * @brief Pixels drawn by offscreen windows, nullptr for real windows
+             *
+             * @see LE_TextureManager::createOffscreenWindow
+             * */
+            SDL_Surface*                        sdl_surface;
+
             /**
              * @brief SDL Renderer instance
              * */
@@ -159,43 +292,195 @@
             /**
              * @brief Loaded textures accessible by Id
              * */
-            std::map<std::string, SDL_Texture*> sdl_textures;
+            std::map<std::string, LE_TextureEntry> sdl_textures;
+
+            /**
+             * @brief Decoded images shared with other windows
+             * */
+            LE_ImageCache*                      images;
+
+            /**
+             * @brief Memory used by the created textures in bytes
+             * */
+            Uint64                              textureBytes;
+
+            /**
+             * @brief Maximum textureBytes before evicting textures, 0 for no limit
+             * */
+            Uint64                              textureBudget;
 
             /**
              * @brief LE_Tile map ordered by id
              * */
             std::map<std::string, LE_Tile*>     tileSet;
 
+            /**
+             * @brief Sprites waiting to be drawn when batching is enabled
+             * */
+            LE_SpriteBatch                      batch;
+
+            /**
+             * @brief Sprites waiting to be sorted when the render queue is enabled
+             * */
+            LE_RenderQueue                      queue;
+
+            /**
+             * @brief Visible area of the current render target, draws
+             * outside of it are culled
+             *
+             * Only valid while viewValid is true
+             * */
+            SDL_Rect                            viewRect;
+            bool                                viewValid;
+
+            /**
+             * @brief true if something changed since the window was last drawn
+             *
+             * @see LE_TextureManager::setDirtyTracking
+             * */
+            bool                                dirty;
+
+            /**
+             * @brief true if the window is being drawn this frame
+             * */
+            bool                                redraw;
+
+            /**
+             * @brief Cached layers of the window by id
+             * */
+            std::map<std::string, LE_CachedLayer> cachedLayers;
+
+            /**
+             * @brief Target textures of popped or resized cached layers,
+             * reused by layers of the same size
+             * */
+            std::vector<SDL_Texture*>           targetPool;
+
+            /**
+             * @brief Popped textures that queued or batched draws may still
+             * use, destroyed once they are drawn
+             * */
+            std::vector<SDL_Texture*>           retired;
+
+            /**
+             * @brief Layer being drawn, nullptr if none
+             *
+             * While set, draws go into its texture shifted by its area origin
+             * */
+            LE_CachedLayer*                     building;
+
+            /**
+             * @brief render target to restore when the layer being drawn ends
+             * */
+            SDL_Texture*                        buildingPrevTarget;
+
+            /**
+             * @brief true while a texture set with setRenderTarget or
+             * createTargetTexture is the render target
+             * */
+            bool                                onTarget;
+
+            /**
+             * @brief offset subtracted from draws into a target texture
+             *
+             * @see LE_TextureManager::setTargetOrigin
+             * */
+            SDL_Point                           targetOrigin;
+
+            /**
+             * @brief Cameras of the window, in creation order
+             * */
+            std::vector<LE_Camera*>             cameras;
+
+            /**
+             * @brief Camera transforming the draws of the current pass,
+             * nullptr if none
+             * */
+            LE_Camera*                          camera;
+
+            /**
+             * @brief true if the current camera pass doesn't draw this window
+             * */
+            bool                                skipPass;
+
+            /**
+             * @brief Get a render target texture from the pool or create it
+             *
+             * @return nullptr on error
+             * */
+            SDL_Texture* acquireTarget ( int h, int w );
+
+            /**
+             * @brief Give a render target texture back to the pool
+             * */
+            void releaseTarget ( SDL_Texture* texture );
+
         public:
             /**
              * @brief Class constructor
              *
              * @param win SDL_Window
              * @param ren SDL_Renderer generated from that window
+             * @param cache image cache shared by every window
              * */
-            LE_Window ( SDL_Window* win, SDL_Renderer* ren ) {
+            LE_Window ( SDL_Window* win, SDL_Renderer* ren, LE_ImageCache* cache ): batch(ren) {
                 sdl_window = win;
+                sdl_surface = nullptr;
                 sdl_renderer = ren;
+                images = cache;
+                textureBytes = textureBudget = 0;
+                viewValid = false;
+                dirty = redraw = true;
+                building = nullptr;
+                buildingPrevTarget = nullptr;
+                onTarget = false;
+                targetOrigin = { 0, 0 };
+                camera = nullptr;
+                skipPass = false;
+            }
+
+            /**
+             * @brief Offscreen window constructor
+             *
+             * @param target surface the renderer draws into, owned by the window
+             * @param ren software renderer generated from that surface
+             * @param cache image cache shared by every window
+             * */
+            LE_Window ( SDL_Surface* target, SDL_Renderer* ren, LE_ImageCache* cache ):
+                LE_Window ( (SDL_Window*)nullptr, ren, cache ) {
+                sdl_surface = target;
             }
+
             /**
              * @brief Class destructor
              *
              * calls LE_Window::clean()
-             * also destroys window and renderer
+             * also destroys window, surface and renderer
              *
              * @see LE_Window::clean
              * */
             ~LE_Window () {
                 clean();
+                for ( LE_Camera* cam : cameras ) delete cam;
                 SDL_DestroyRenderer( sdl_renderer );
-                SDL_DestroyWindow( sdl_window );
+                if ( sdl_window != nullptr ) SDL_DestroyWindow( sdl_window );
+                if ( sdl_surface != nullptr ) SDL_FreeSurface( sdl_surface );
             }
 
             /**
              * @brief sdl_window getter function
+             *
+             * nullptr for offscreen windows
              * */
             SDL_Window* getWindow () { return sdl_window; }
 
+            /**
+             * @brief sdl_surface getter function
+             *
+             * nullptr for real windows
+             * */
+            SDL_Surface* getSurface () { return sdl_surface; }
+
             /**
              * @brief sdl_renderer getter function
              * */
@@ -215,9 +500,56 @@
                         << std::endl;
                     return;
                 }
-                sdl_textures[textureId] = newTexture;
+                LE_TextureEntry entry = newEntry ( "" );
+                entry.texture = newTexture;
+                entry.bytes = textureSize ( newTexture, &entry.h, &entry.w );
+                textureBytes += entry.bytes;
+                sdl_textures[textureId] = entry;
+            }
+
+            /**
+             * @brief add a texture created from a cached image
+             *
+             * The texture is created the first time it is used. The window
+             * must hold a reference to filePath in the image cache, which
+             * is released along with the texture.
+             *
+             * @param textureId Id to refference that texture
+             * @param filePath cached image path
+             * */
+            void addImage ( std::string textureId, std::string filePath ) {
+                auto it = sdl_textures.find( textureId );
+                if ( it != sdl_textures.end() ) {
+                    std::cerr << "The texture ID: " << textureId << " is already in use"
+                        << ". Must deallocate previous texture before reloading it"
+                        << std::endl;
+                    images->release ( filePath );
+                    return;
+                }
+                LE_TextureEntry entry = newEntry ( filePath );
+                entry.imageHeld = true;
+                SDL_Surface* surface = images->get ( filePath );
+                if ( surface != nullptr ) {
+                    entry.w = surface->w;
+                    entry.h = surface->h;
+                }
+                sdl_textures[textureId] = entry;
+            }
+
+            /**
+             * @brief returns true if the texture exists, even if not created yet
+             * */
+            bool hasTexture ( const std::string& textureId ) {
+                return sdl_textures.find( textureId ) != sdl_textures.end();
             }
 
+            /**
+             * @brief get texture size without creating it
+             *
+             * @return false if the texture doesn't exist
+             * */
+            bool getTextureSize ( const std::string& textureId, int* h, int* w );
+
             /**
              * @brief pop a texture from LE_Window::sdl_textures
              *
@@ -226,7 +558,11 @@
             void popTexture ( std::string textureId ) {
                 auto it = sdl_textures.find(textureId);
                 if (it != sdl_textures.end()) {
-                    SDL_DestroyTexture ( it->second );
+                    if ( it->second.texture != nullptr )
+                        retired.push_back ( it->second.texture );
+                    if ( it->second.imageHeld )
+                        images->release ( it->second.filePath );
+                    textureBytes -= it->second.bytes;
                     sdl_textures.erase(it);
                 }
             }
@@ -234,19 +570,74 @@
             /**
              * @brief get textures by id
              *
+             * Textures loaded from images are created here the first
+             * time they are requested.
              * Returns a nullptr if the texture doesn't exist
              *
              * @param textureId
              * @return SDL_Texture* instance
              * */
-            SDL_Texture* getTexture ( std::string textureId ) {
+            SDL_Texture* getTexture ( const std::string& textureId ) {
+                LE_TextureEntry* entry = getEntry ( textureId );
+                return entry != nullptr ? entry->texture : nullptr;
+            }
+
+            /**
+             * @brief get a texture entry by id, creating its texture if needed
+             *
+             * Returns a nullptr if the texture doesn't exist or can't be created
+             * */
+            LE_TextureEntry* getEntry ( const std::string& textureId ) {
                 auto it = sdl_textures.find(textureId);
-                if (it != sdl_textures.end()) {
-                    return it->second;
-                }
-                return nullptr;
+                if (it == sdl_textures.end()) return nullptr;
+                if ( it->second.texture == nullptr && !createTexture ( it->second ) )
+                    return nullptr;
+                return &it->second;
+            }
+
+            /**
+             * @brief Create the texture of an entry from its image
+             *
+             * The image is decoded again if it was released on eviction
+             *
+             * @return false if it can't be created
+             * */
+            bool createTexture ( LE_TextureEntry& entry );
+
+            /**
+             * @brief Destroy the texture of an entry loaded from an image
+             *
+             * The entry is kept and its texture is created again on its next use
+             * */
+            void evict ( LE_TextureEntry& entry );
+
+            /**
+             * @brief Evict the least recently drawn textures until
+             * textureBytes is under textureBudget
+             *
+             * Textures drawn on frame currentFrame are never evicted
+             *
+             * @return number of textures evicted
+             * */
+            int evictUntilUnderBudget ( Uint32 currentFrame );
+
+            /**
+             * @brief returns true if the window has a budget and is over it
+             * */
+            bool overBudget () {
+                return textureBudget > 0 && textureBytes > textureBudget;
             }
 
+            /**
+             * @brief Entry with every field initialized
+             * */
+            static LE_TextureEntry newEntry ( const std::string& filePath );
+
+            /**
+             * @brief Memory used by a texture: bytes per pixel * w * h
+             * */
+            static Uint64 textureSize ( SDL_Texture* texture, int* h = nullptr, int* w = nullptr );
+
             /**
              * @brief add a tile to LE_Window::tileSet
              *
@@ -282,7 +673,7 @@
              * @param tileId
              * @return LE_Tile
              * */
-            LE_Tile* getTile ( std::string tileId ) {
+            LE_Tile* getTile ( const std::string& tileId ) {
                 auto it = tileSet.find(tileId);
                 if (it != tileSet.end()) {
                     return it->second;
@@ -291,14 +682,73 @@
             }
 
             /**
-             * @brief Free memory allocated for sdl_textures and tileSet
+             * @brief Free memory allocated for sdl_textures, tileSet and
+             * cached layers
              *
-             * Clears sdl_textures and tileSet maps
+             * Clears sdl_textures, tileSet and cachedLayers maps
              * */
             void clean();
 
     };
 
+    /**
+     * @brief Cached draw data behind a LE_TileHandle
+     *
+     * Entries are resolved lazily: when the window, tile or texture an entry
+     * was resolved with is modified or removed, that entry is marked
+     * unresolved and looked up again by id on its next draw. Entries of
+     * evicted textures are looked up again when their texture doesn't
+     * match the one of the texture entry anymore.
+     * */
+    typedef struct LE_ResolvedTile {
+        Uint32 windowId;
+        std::string tileId;
+
+        /**
+         * @brief Incremented whenever what the entry draws may have changed
+         *
+         * @see LE_TextureManager::getTileVersion
+         * */
+        Uint32 version;
+
+        /** @brief true if the last lookup failed */
+        bool failed;
+
+        /** @brief nullptr while the entry is not resolved */
+        LE_Window* window;
+        LE_TextureEntry* entry;
+        LE_Tile* tile;
+        SDL_Texture* texture;
+        SDL_Rect src;
+
+        /**
+         * @brief untrimmed tile frame: x and y are the trimmed offsets,
+         * w and h the original size
+         * */
+        SDL_Rect frame;
+
+        int texW;
+        int texH;
+        SDL_BlendMode blendMode;
+        SDL_Color color;
+    } LE_ResolvedTile;
+
+    /**
+     * @brief Rendering counters of a frame
+     *
+     * @see LE_TextureManager::getRenderStats
+     * */
+    typedef struct LE_RenderStats {
+        /** @brief sprites drawn through LE_TextureManager::draw, after culling */
+        Uint32 sprites;
+        /** @brief sprites skipped for being outside of the view */
+        Uint32 culled;
+        /** @brief SDL_RenderCopyEx and SDL_RenderGeometry calls issued */
+        Uint32 drawCalls;
+        /** @brief textures destroyed to stay under a texture budget */
+        Uint32 evictions;
+    } LE_RenderStats;
+
     /**
      * @brief Manages Window, Texture and Tile creation in a single project
      *
@@ -319,6 +769,8 @@
      * */
     class LE_TextureManager
     {
+        friend class LE_Tile;
+
         private:
 
             /**
@@ -351,336 +803,1336 @@
             std::map<Uint32, LE_Window*> windows;
 
             /**
-             * @brief saves the singleton's instance
+             * @brief Storage for tile handles, a LE_TileHandle indexes this deque
+             *
+             * A deque so entries don't move when handles are resolved from
+             * another thread while the main thread draws.
              * */
-            static LE_TextureManager* tm_instance;
+            std::deque<LE_ResolvedTile> tileHandles;
 
             /**
-             * @brief Class constructor
+             * @brief Guards tileHandles and tileHandleIndex
              *
-             * Initializes SDL, SDL Image and SDL TTF
+             * Only the main thread changes resolved entries, other threads
+             * may only add new ones through resolveTile.
              * */
-            LE_TextureManager () {
-                sdl_initialized = sdl_image_initialized = sdl_ttf_initialized = false;
-                init();
-            }
+            std::mutex handleMutex;
 
-        public:
             /**
-             * @brief Class destructor
+             * @brief Maps a (windowId, tileId) pair to its handle so resolving
+             * the same tile twice returns the same handle
+             * */
+            std::map<std::pair<Uint32, std::string>, LE_TileHandle> tileHandleIndex;
+
+            /**
+             * @brief Mark the resolved tile handles drawing from a window, a
+             * texture or a tile to be looked up again on their next draw
              *
-             * In case that the singleton is destructed, it will
-             * perform the pertinent cleanning using the clean() method.
+             * Called before any of them is modified or deleted, nullptr
+             * arguments match no handle.
              * */
-            ~LE_TextureManager () { clean(); }
+            void invalidateTileHandles ( LE_Window* window, LE_TextureEntry* entry, LE_Tile* tile );
 
             /**
-             * @brief Initializes SDL and it's extensions
+             * @brief Bump the version of the handles of a window that failed
+             * to be resolved, when a texture is added to it
              * */
-            void init ();
+            void retryTileHandles ( Uint32 windowId );
 
             /**
-             * @brief Deinitialize SDL Libraries
+             * @brief When true, draws are accumulated into each window's LE_SpriteBatch
              * */
-            void clean ();
+            bool batching;
 
             /**
-             * @brief creates a new Window and Renderer
-             *
-             * This also creates a renderer for that window
-             *
-             * If the returned window ID is 0, then there was an error
-             * during the window creation.
-             *
-             * @param title Window title
-             * @param h Window Height
-             * @param w Window width
-             * @param full_screen Set window to full screen
-             * @param input_focus Set Input focus on this window
-             * @param hidden Hide this window when created
-             * @param resizable Window is resizable
-             * @param gpu SDL will try to use gpu on rendering
+             * @brief When true, draws are sorted in each window's LE_RenderQueue
              * */
-            Uint32 createWindow (
-                   const char* title,
-                   int h,
-                   int w,
-                   bool full_screen = false,
-                   bool input_focus = false,
-                   bool hidden = false,
-                   bool borderless = false,
-                   bool resizable = false);
+            bool renderQueue;
 
             /**
-             * @brief add an existing window
-             *
-             * @return window ID
+             * @brief When true, draws outside of the window view are skipped
              * */
-            Uint32 addWindow ( SDL_Window* newWindow );
+            bool culling;
 
             /**
-             * @brief Cleans tiles and textures on a window
-             *
-             * @param windowId
+             * @brief When true, only windows marked dirty are drawn by LE_Game
              * */
-            void cleanWindow ( Uint32 windowId ) {
-                auto it = windows.find(windowId);
-                if (it != windows.end()) {
-                    it->second->clean();
-                }
-            }
+            bool dirtyTracking;
 
+            /**
+             * @brief When true, createWindow creates offscreen windows
+             * */
+            bool headless;
 
             /**
-             * @brief Destroy a window by it's ID
+             * @brief Id given to the next offscreen window
              *
-             * @param windowId
+             * Starts far above the ids SDL gives to real windows
              * */
-            void popWindow ( Uint32 windowId ) {
-                auto it = windows.find(windowId);
-                if (it != windows.end()) {
-                    delete it->second;
-                    windows.erase(it);
-                }
-            }
+            Uint32 nextOffscreenId;
 
             /**
-             * @brief Get the size of a window
+             * @brief Copy what was drawn in the current render target of
+             * a window into a new ARGB8888 surface
              *
-             * @param windowId
-             * @param height int pointer where to save the window height
-             * @param width int pointer where to save the window widht
+             * @return nullptr on error, the caller frees the surface
              * */
-            void getWindowSize ( Uint32 windowId, int* height, int* width ) {
-                auto it = windows.find(windowId);
-                if (it != windows.end()) {
-                    SDL_GetWindowSize ( it->second->getWindow(), width, height );
+            SDL_Surface* readFrame ( LE_Window* window );
+
+            /**
+             * @brief Get the view of a window, computing it if needed
+             * */
+            const SDL_Rect& windowView ( LE_Window* window ) {
+                if ( !window->viewValid ) {
+                    SDL_Rect viewport;
+                    SDL_RenderGetViewport ( window->sdl_renderer, &viewport );
+                    window->viewRect = { 0, 0, viewport.w, viewport.h };
+
+                    // Draws into a cached layer are in window coordinates
+                    if ( window->building != nullptr ) {
+                        window->viewRect.x = window->building->area.x;
+                        window->viewRect.y = window->building->area.y;
+                    } else if ( window->onTarget ) {
+                        window->viewRect.x = window->targetOrigin.x;
+                        window->viewRect.y = window->targetOrigin.y;
+                    } else if ( window->camera != nullptr ) {
+                        window->viewRect = window->camera->worldView();
+                    }
+                    window->viewValid = true;
                 }
+                return window->viewRect;
             }
 
             /**
-             * @brief Get window renderer
-             *
-             * @param windowId
-             * @return SDL_Renderer*
+             * @brief Counters of the frame being drawn
              * */
-            SDL_Renderer* getRenderer ( Uint32 windowId ) {
+            LE_RenderStats stats;
+
+            /**
+             * @brief Counters of the last complete frame
+             * */
+            LE_RenderStats lastStats;
+
+            /**
+             * @brief Size in pixels of the atlas pages created by loadFromXmlFile
+             * */
+            int atlasPageSize;
+
+            /**
+             * @brief Decodes asynchronous loads, created on the first one
+             * */
+            LE_TextureLoader* loader;
+
+            /**
+             * @brief Number of threads the loader is created with
+             * */
+            int loaderThreads;
+
+            /**
+             * @brief Milliseconds processAsyncLoads can spend creating textures
+             * */
+            double uploadBudget;
+
+            /**
+             * @brief Decoded images shared by every window
+             * */
+            LE_ImageCache imageCache;
+
+            /**
+             * @brief Adds a texture created from an image of the image cache
+             *
+             * @param decoded image already decoded from filePath, or nullptr
+             * to decode it if it isn't cached. Always taken by the cache.
+             * @return false if the window doesn't exist, the id is in use
+             * or the image can't be decoded
+             * */
+            bool addImageTexture ( Uint32 windowId, const std::string& filePath,
+                    const std::string& textureId, SDL_Surface* decoded );
+
+            /**
+             * @brief Frames started with beginFrame, used to find the least
+             * recently drawn textures
+             * */
+            Uint32 frameCount;
+
+            /**
+             * @brief Evicts textures of a window if it is over its budget
+             * */
+            void checkBudget ( LE_Window* window ) {
+                // Textures drawn this frame are kept, nothing queued is evicted
+                if ( window->overBudget() ) {
+                    stats.evictions += window->evictUntilUnderBudget ( frameCount );
+                }
+            }
+
+            /**
+             * @brief Looks up the window, tile and texture of a tile handle entry
+             *
+             * @return false if any of them doesn't exist
+             * */
+            bool resolveHandle ( LE_ResolvedTile& entry );
+
+            /**
+             * @brief Fills texture size, blend mode and color modulation of a draw command
+             *
+             * @return false if the texture can't be queried
+             * */
+            bool setCommandTexture ( LE_DrawCommand& cmd, SDL_Texture* texture );
+
+            /**
+             * @brief Common part of both LE_TextureManager::draw overloads
+             *
+             * cmd must already have its texture data and source rect filled,
+             * this sets the destination, rotation and flip, then submits it.
+             *
+             * @param frame untrimmed tile frame, see LE_ResolvedTile::frame
+             * */
+            bool drawTile ( LE_Window* window, LE_DrawCommand& cmd, const SDL_Rect& frame,
+                        int x, int y, double h, double w,
+                        bool scale, bool flipv, bool fliph, const double angle,
+                        int layer, int z, bool screenSpace );
+
+            /**
+             * @brief returns true if the bounding box of a command overlaps view
+             * */
+            static bool isVisible ( const SDL_Rect& view, const LE_DrawCommand& cmd );
+
+            /**
+             * @brief returns true if draws into a window are dropped, when
+             * it isn't redrawn this frame or this camera pass
+             * */
+            bool dropsDraws ( LE_Window* window ) {
+                if ( window->onTarget || window->building != nullptr ) return false;
+                return window->skipPass || ( dirtyTracking && !window->redraw );
+            }
+
+            /**
+             * @brief Move a command from window coordinates to render target
+             * coordinates: by the cached layer or target origin, or by the
+             * camera of the current pass
+             *
+             * @param screenSpace ignore the camera
+             * */
+            void transformCommand ( LE_Window* window, LE_DrawCommand& cmd, bool screenSpace );
+
+            /**
+             * @brief Draws a command right away or appends it to the window batch
+             * */
+            bool submit ( LE_Window* window, const LE_DrawCommand& cmd, int layer, int z );
+
+            /**
+             * @brief Draws a command right away or appends it to the window batch
+             *
+             * Called by submit, or for each command of the render queue once sorted
+             * */
+            bool dispatch ( LE_Window* window, const LE_DrawCommand& cmd );
+
+            /**
+             * @brief Draws the sprites queued and batched for a window
+             *
+             * The queue is kept while drawing into a render target or a
+             * cached layer, it is drawn into the window.
+             * */
+            void flushWindow ( LE_Window* window ) {
+                LE_PROFILE_SCOPE ( "draw batch" );
+                if ( !window->queue.empty() && !window->onTarget && window->building == nullptr ) {
+                    window->queue.sort();
+                    for ( size_t i = 0; i < window->queue.size(); i++ )
+                        dispatch ( window, window->queue[i] );
+                    window->queue.clear();
+                }
+                flushBatch ( window );
+            }
+
+            /**
+             * @brief Draws the sprites batched for a window, keeping the
+             * queued ones
+             *
+             * Used when the render target or a texture state change in the
+             * middle of a frame, since queued draws keep their order only
+             * if the queue is drawn at once.
+             * */
+            void flushBatch ( LE_Window* window ) {
+                stats.drawCalls += window->batch.flush();
+                if ( window->queue.empty() ) {
+                    for ( SDL_Texture* texture : window->retired ) SDL_DestroyTexture ( texture );
+                    window->retired.clear();
+                }
+            }
+
+            /**
+             * @brief saves the singleton's instance
+             * */
+            static LE_TextureManager* tm_instance;
+
+            /**
+             * @brief Class constructor
+             *
+             * Initializes SDL, SDL Image and SDL TTF
+             * */
+            LE_TextureManager () {
+                sdl_initialized = sdl_image_initialized = sdl_ttf_initialized = false;
+                batching = false;
+                renderQueue = false;
+                culling = true;
+                dirtyTracking = false;
+                headless = false;
+                nextOffscreenId = 0x80000000;
+                stats = lastStats = { 0, 0, 0, 0 };
+                frameCount = 1;
+                atlasPageSize = 2048;
+                loader = nullptr;
+                loaderThreads = std::max ( 1, std::min ( 4, SDL_GetCPUCount() - 1 ) );
+                uploadBudget = 2;
+                init();
+            }
+
+        public:
+            /**
+             * @brief Class destructor
+             *
+             * In case that the singleton is destructed, it will
+             * perform the pertinent cleanning using the clean() method.
+             * */
+            ~LE_TextureManager () { clean(); }
+
+            /**
+             * @brief Initializes SDL and it's extensions
+             * */
+            void init ();
+
+            /**
+             * @brief Deinitialize SDL Libraries
+             * */
+            void clean ();
+
+            /**
+             * @brief creates a new Window and Renderer
+             *
+             * This also creates a renderer for that window
+             *
+             * If the returned window ID is 0, then there was an error
+             * during the window creation.
+             *
+             * In headless mode an offscreen window of the same size is
+             * created instead and the other options are ignored.
+             *
+             * @see LE_TextureManager::setHeadless
+             * @param title Window title
+             * @param h Window Height
+             * @param w Window width
+             * @param full_screen Set window to full screen
+             * @param input_focus Set Input focus on this window
+             * @param hidden Hide this window when created
+             * @param resizable Window is resizable
+             * @param gpu SDL will try to use gpu on rendering
+             * */
+            Uint32 createWindow (
+                   const char* title,
+                   int h,
+                   int w,
+                   bool full_screen = false,
+                   bool input_focus = false,
+                   bool hidden = false,
+                   bool borderless = false,
+                   bool resizable = false);
+
+            /**
+             * @brief add an existing window
+             *
+             * @return window ID
+             * */
+            Uint32 addWindow ( SDL_Window* newWindow );
+
+            /**
+             * @brief creates a window without a display
+             *
+             * A software renderer draws into an ARGB8888 surface. Offscreen
+             * windows work with the same window ID API as real windows,
+             * presenting them does nothing and their pixels can be read
+             * with dumpFrame and frameChecksum at any time.
+             *
+             * @param h surface height
+             * @param w surface width
+             * @return window ID, 0 on error
+             * */
+            Uint32 createOffscreenWindow ( int h, int w );
+
+            /**
+             * @brief Make createWindow create offscreen windows
+             *
+             * Used by \ref LE_Init "LE_Init(true)" to run games and
+             * benchmark scenes on machines without a display. Only affects
+             * windows created after calling it.
+             *
+             * @param enabled
+             * */
+            void setHeadless ( bool enabled ) { headless = enabled; }
+
+            /**
+             * @brief returns true if createWindow creates offscreen windows
+             * */
+            bool isHeadless () { return headless; }
+
+            /**
+             * @brief Save what was drawn into a window to an image file
+             *
+             * Saves a PNG if filePath ends with .png and a BMP otherwise.
+             * Pending draws are flushed first. Reads the current render
+             * target; for real windows call it before presenting, since the
+             * contents of the back buffer are undefined after that.
+             *
+             * @param windowId
+             * @param filePath
+             * @return false on error
+             * */
+            bool dumpFrame ( Uint32 windowId, std::string filePath );
+
+            /**
+             * @brief 64 bit FNV-1a hash of what was drawn into a window
+             *
+             * Hashes the size and the ARGB8888 pixels of the current render
+             * target, to compare frames against known good values in
+             * golden tests. Same timing rules as dumpFrame.
+             *
+             * @param windowId
+             * @return checksum, 0 on error
+             * */
+            Uint64 frameChecksum ( Uint32 windowId );
+
+            /**
+             * @brief Cleans tiles and textures on a window
+             *
+             * @param windowId
+             * */
+            void cleanWindow ( Uint32 windowId ) {
+                auto it = windows.find(windowId);
+                if (it != windows.end()) {
+                    invalidateTileHandles ( it->second, nullptr, nullptr );
+                    it->second->clean();
+                    it->second->dirty = true;
+                }
+            }
+
+
+            /**
+             * @brief Destroy a window by it's ID
+             *
+             * @param windowId
+             * */
+            void popWindow ( Uint32 windowId ) {
+                auto it = windows.find(windowId);
+                if (it != windows.end()) {
+                    invalidateTileHandles ( it->second, nullptr, nullptr );
+                    delete it->second;
+                    windows.erase(it);
+                }
+            }
+
+            /**
+             * @brief Get the size of a window
+             *
+             * @param windowId
+             * @param height int pointer where to save the window height
+             * @param width int pointer where to save the window widht
+             * */
+            void getWindowSize ( Uint32 windowId, int* height, int* width ) {
+                auto it = windows.find(windowId);
+                if (it == windows.end()) return;
+
+                SDL_Surface* surface = it->second->getSurface();
+                if ( surface != nullptr ) {
+                    if ( height != nullptr ) *height = surface->h;
+                    if ( width != nullptr ) *width = surface->w;
+                } else {
+                    SDL_GetWindowSize ( it->second->getWindow(), width, height );
+                }
+            }
+
+            /**
+             * @brief Get window renderer
+             *
+             * @param windowId
+             * @return SDL_Renderer*
+             * */
+            SDL_Renderer* getRenderer ( Uint32 windowId ) {
+                auto it = windows.find(windowId);
+                if (it != windows.end()) {
+                    return it->second->getRenderer();
+                }
+                return nullptr;
+            }
+
+            /**
+             * @brief Load an sdl texture from a png file
+             *
+             * @param windowId
+             * @param filePath PNG file path
+             * @param textureId the generated texture will be refferenced by it
+             * */
+            void loadTexture ( Uint32 windowId,
+                    std::string filePath,
+                    std::string textureId );
+
+            /**
+             * @brief Load an sdl texture from a png file without blocking
+             *
+             * The image is decoded on a worker thread, and the texture is
+             * created on the main thread by processAsyncLoads, which
+             * LE_Game calls every frame.
+             *
+             * @param windowId
+             * @param filePath PNG file path
+             * @param textureId the generated texture will be refferenced by it
+             * @param onDone called on the main thread once the texture exists,
+             * with false if it couldn't be loaded
+             * */
+            void loadTextureAsync ( Uint32 windowId, std::string filePath,
+                    std::string textureId, LE_LoadCallback onDone = nullptr );
+
+            /**
+             * @brief Create the textures decoded so far
+             *
+             * Keeps creating textures and running their callbacks until
+             * the upload budget is spent, at least one per call.
+             * Called by LE_Game every frame.
+             *
+             * @see LE_TextureManager::setUploadBudget
+             * */
+            void processAsyncLoads ();
+
+            /**
+             * @brief Set how long processAsyncLoads can take per frame
+             *
+             * @param ms milliseconds, 2 by default
+             * */
+            void setUploadBudget ( double ms ) { uploadBudget = ms; }
+
+            /**
+             * @brief Set the number of threads decoding images
+             *
+             * Takes effect once no asynchronous load is in progress.
+             * By default one less than the number of CPUs, up to 4.
+             *
+             * @param threads
+             * */
+            void setLoaderThreads ( int threads );
+
+            /**
+             * @brief Number of asynchronous texture loads not finished yet
+             * */
+            int getPendingLoads () { return loader != nullptr ? loader->count() : 0; }
+
+            /**
+             * @brief Add a texture from an existing SDL_Texture  object
+             *
+             * @param windowId
+             * @param textureId the texture will be accessible by this Id
+             * @param nT SDL_Texture* object
+             * */
+            void addTexture ( Uint32 windowId, std::string textureId, SDL_Texture* nT ) {
+                auto it = windows.find( windowId );
+                if ( it != windows.end() ) {
+                    it->second->addTexture( textureId, nT );
+                    it->second->dirty = true;
+                    retryTileHandles ( windowId );
+                }
+            }
+
+            void getTextureSize ( Uint32 windowId, std::string textureId,
+                    int* height, int* width ) {
+                auto it = windows.find(windowId);
+                if (it == windows.end()) {
+                    *height = *width = -1;
+                    return;
+                }
+
+                it->second->getTextureSize ( textureId, height, width );
+            }
+
+            /**
+             * @brief Remove a texture by it's ID
+             *
+             * @param windowId
+             * @param textureId
+             * */
+            void popTexture ( Uint32 windowId, std::string textureId ) {
+                auto it = windows.find( windowId );
+                if ( it != windows.end() ) {
+                    // Draws already queued are kept, LE_Window::popTexture
+                    // destroys the texture once they are drawn
+                    auto found = it->second->sdl_textures.find ( textureId );
+                    if ( found != it->second->sdl_textures.end() )
+                        invalidateTileHandles ( nullptr, &found->second, nullptr );
+                    it->second->popTexture( textureId );
+                    it->second->dirty = true;
+                }
+            }
+
+            /**
+             * @brief add a Tile from existing LE_Tile object
+             *
+             * @param windowId
+             * @param tileId Id for the new tile
+             * @param newTile LE_Tile object to add
+             * */
+            void addTile ( Uint32 windowId, std::string tileId, LE_Tile* newTile ) {
+                auto it = windows.find( windowId );
+                if ( it == windows.end() ) {
+                    std::cerr << "Error adding tile: window id " << windowId <<
+                        " doesn't exist" << std::endl;
+                    return;
+                }
+                // Handles of a replaced tile must not keep drawing it
+                LE_Tile* previous = it->second->getTile ( tileId );
+                if ( previous != nullptr ) invalidateTileHandles ( nullptr, nullptr, previous );
+                it->second->addTile ( tileId, newTile );
+                it->second->dirty = true;
+
+                std::lock_guard<std::mutex> lock ( handleMutex );
+                auto handle = tileHandleIndex.find ( std::make_pair ( windowId, tileId ) );
+                if ( handle != tileHandleIndex.end() ) tileHandles[handle->second].version++;
+            }
+
+            /**
+             * @brief Adds a tile to the tile map
+             *
+             * if h or w are entered as 0, the tile will
+             * match the texture size
+             *
+             * @param windowId
+             * @param textureId
+             * @param tileId
+             * @param x tile x coord
+             * @param y tile y coord
+             * @param h tile height
+             * @param w tile width
+             * */
+            void createTile ( Uint32 windowId,
+                    std::string textureId,
+                    std::string tileId,
+                    int x = 0, int y = 0, int h = 0, int w = 0 );
+
+            /**
+             * @brief Delete tile by Id
+             *
+             * @param windowId
+             * @param tileId
+             * */
+            void popTile ( Uint32 windowId, std::string tileId ) {
+                auto it = windows.find( windowId );
+                if ( it != windows.end() ) {
+                    LE_Tile* tile = it->second->getTile ( tileId );
+                    if ( tile != nullptr ) invalidateTileHandles ( nullptr, nullptr, tile );
+                    it->second->popTile( tileId );
+                    it->second->dirty = true;
+                }
+            }
+
+            /**
+             * @brief Chekc if sdl is initialized
+             *
+             * @return true sdl is initialized
+             * */
+            bool SDLWasInit () { return sdl_initialized; }
+
+            /**
+             * @brief Chekc if sdl_image is initialized
+             *
+             * @return true sdl_image is initialized
+             * */
+            bool ImageWasInit () { return sdl_image_initialized; }
+
+            /**
+             * @brief Chekc if sdl_ttf is initialized
+             *
+             * @return true sdl_ttf is initialized
+             * */
+            bool TTFWasInit () { return sdl_ttf_initialized; }
+
+            /**
+             * @brief Check if all sdl subsystems were initialized
+             *
+             * @return true if all subsystems were initialized
+             * */
+            bool EverythingWasInit() {
+                return ( sdl_initialized && sdl_image_initialized && sdl_ttf_initialized );
+            }
+
+            /**
+             * @brief Returns the LE_TextureManager instance
+             * */
+            static LE_TextureManager* Instance () {
+                if ( tm_instance == nullptr ) {
+                    tm_instance = new LE_TextureManager ();
+                }
+                return tm_instance;
+            }
+
+            /**
+             * @brief Destroy LE_TextureManager instance
+             *
+             * called inside LE_Quit()
+             * */
+            static void destroyInstance () {
+                if ( tm_instance != nullptr ) {
+                    delete tm_instance;
+                    tm_instance = nullptr;
+                }
+            }
+
+            /**
+             * @brief Fill background with a plain rgb color
+             * */
+            bool fillBackground ( Uint32 windowId, Uint8 r, Uint8 g, Uint8 b, Uint8 a ) {
+                auto it = windows.find( windowId );
+                if ( it != windows.end() ) {
+                    LE_Window* leText = it->second;
+                    flushWindow ( leText );
+                    SDL_SetRenderDrawColor ( leText->getRenderer(), r, g, b, a );
+                    SDL_RenderClear ( leText->getRenderer() );
+                    return true;
+                }
+                // Window for this id does not exist
+                return false;
+            }
+
+            /**
+             * @brief Renders all elements that have been drawn onto the window
+             *
+             * @param windowId
+             * */
+            bool present ( Uint32 windowId ) {
+                auto it = windows.find(windowId);
+                if ( it != windows.end() ) {
+                    flushWindow ( it->second );
+                    SDL_RenderPresent ( it->second->getRenderer() );
+                    return true;
+                }
+                return false;
+            }
+
+            /**
+             * @brief draw a tile
+             *
+             * The tile is only drawn into the window corresponding to
+             * the windowId inserted and also, the textureId referenced
+             * into that tile must exist in that window sdl_textures map
+             *
+             * Note: in order to the tiles drawn to be shown in a window,
+             * call LE_TextureManager::present(windowId)
+             *
+             * @param windowId
+             * @param tileId
+             * @param x coord to draw the tile into the window
+             * @param y coord to draw the tile into the window
+             * @param h if scale is set to true, works a a multipier for the actual tile height, it works as an absolute height modifier.
+             * @param w if scale is set to true, works a a multipier for the actual tile width, it works as an absolute width modifier.
+             * @param scale set to false to set h and w as absolute size modifier
+             * @param flipv flip the image vertically
+             * @param fliph flip the image horizontally
+             * @param angle
+             * @param layer draw order when the render queue is enabled, lower first
+             * @param z draw order inside the layer when the render queue is enabled
+             * @param screenSpace x and y are relative to the camera viewport
+             * instead of world coordinates, for HUDs
+             * @return true if the draw was completed without error
+             * */
+            bool draw ( Uint32 windowId, const std::string& tileId,
+                        int x, int y, double h = 1, double w = 1,
+                        bool scale = true, bool flipv = false,
+                        bool fliph = false, const double angle = 0,
+                        int layer = 0, int z = 0, bool screenSpace = false );
+
+            /**
+             * @brief Get a handle to draw a tile without looking it up by id
+             *
+             * Resolving the same tile twice returns the same handle. The tile
+             * doesn't need to exist yet, the handle is resolved on its first draw
+             * and again whenever its own tile or texture change, so handles stay
+             * valid across texture reloads.
+             *
+             * Safe to call from any thread, like LE_GameState::on_preload
+             * building its objects on a LE_JOBS worker.
+             *
+             * @param windowId
+             * @param tileId
+             * @return LE_TileHandle
+             * */
+            LE_TileHandle resolveTile ( Uint32 windowId, const std::string& tileId );
+
+            /**
+             * @brief draw a tile from its handle
+             *
+             * Same as the windowId/tileId overload, but without any map lookup
+             * when the handle is already resolved.
+             *
+             * @param tileHandle handle returned by LE_TextureManager::resolveTile
+             * @param x coord to draw the tile into the window
+             * @param y coord to draw the tile into the window
+             * @param h if scale is set to true, works a a multipier for the actual tile height, it works as an absolute height modifier.
+             * @param w if scale is set to true, works a a multipier for the actual tile width, it works as an absolute width modifier.
+             * @param scale set to false to set h and w as absolute size modifier
+             * @param flipv flip the image vertically
+             * @param fliph flip the image horizontally
+             * @param angle
+             * @param layer draw order when the render queue is enabled, lower first
+             * @param z draw order inside the layer when the render queue is enabled
+             * @param screenSpace x and y are relative to the camera viewport
+             * instead of world coordinates, for HUDs
+             * @return true if the draw was completed without error
+             * */
+            bool draw ( LE_TileHandle tileHandle,
+                        int x, int y, double h = 1, double w = 1,
+                        bool scale = true, bool flipv = false,
+                        bool fliph = false, const double angle = 0,
+                        int layer = 0, int z = 0, bool screenSpace = false );
+
+            /**
+             * @brief Enable or disable sprite batching
+             *
+             * While enabled, consecutive draws into a window that share texture
+             * and blend mode are merged into a single SDL_RenderGeometry call.
+             * Batches are flushed automatically when presenting, clearing the
+             * window or changing its render target, call
+             * LE_TextureManager::flush before drawing with SDL directly into a
+             * renderer that has pending sprites.
+             *
+             * Disabled by default, requires SDL 2.0.18 or newer.
+             *
+             * @param enabled
+             * */
+            void setBatching ( bool enabled ) {
+                if ( !enabled ) {
+                    for ( auto it = windows.begin(); it != windows.end(); it++ )
+                        flushWindow ( it->second );
+                }
+                batching = enabled;
+            }
+
+            /**
+             * @brief returns true if sprite batching is enabled
+             * */
+            bool isBatching () { return batching; }
+
+            /**
+             * @brief Enable or disable the render queue
+             *
+             * While enabled, draws are not sent to SDL right away but queued
+             * per window, and sorted by layer, z and texture when flushed
+             * (when presenting, clearing the window, changing its render
+             * target or calling LE_TextureManager::flush). Sprites with the
+             * same layer and z may be reordered to group them by texture,
+             * which reduces draw calls when combined with sprite batching.
+             *
+             * Disabled by default, draws are then done in call order.
+             *
+             * Draws into render targets and cached layers are not queued,
+             * they are drawn in call order into their texture.
+             *
+             * @see LE_RenderQueue
+             *
+             * @param enabled
+             * */
+            void enableRenderQueue ( bool enabled ) {
+                if ( !enabled ) {
+                    for ( auto it = windows.begin(); it != windows.end(); it++ )
+                        flushWindow ( it->second );
+                }
+                renderQueue = enabled;
+            }
+
+            /**
+             * @brief returns true if the render queue is enabled
+             * */
+            bool isRenderQueueEnabled () { return renderQueue; }
+
+            /**
+             * @brief Enable or disable dirty tracking
+             *
+             * While enabled, LE_Game::render only clears, draws and presents
+             * the windows marked dirty since their last frame, the rest keep
+             * showing their last frame. Windows are marked dirty when game
+             * objects of the current state move or change frame, objects or
+             * states are added or removed, tile maps are edited, textures or
+             * tiles change, cameras move, and on window expose or resize
+             * events. Objects with a custom render should call
+             * LE_GameObject::markDirty when they change in ways the engine
+             * can't see.
+             *
+             * Draws into windows that are not being redrawn are skipped,
+             * unless a render target is set.
+             *
+             * Disabled by default
+             *
+             * @param enabled
+             * */
+            void setDirtyTracking ( bool enabled ) {
+                dirtyTracking = enabled;
+                markAllDirty();
+            }
+
+            /**
+             * @brief returns true if dirty tracking is enabled
+             * */
+            bool isDirtyTracking () { return dirtyTracking; }
+
+            /**
+             * @brief Mark a window to be drawn on the next frame
+             *
+             * @param windowId
+             * */
+            void markDirty ( Uint32 windowId ) {
+                auto it = windows.find(windowId);
+                if ( it != windows.end() ) it->second->dirty = true;
+            }
+
+            /**
+             * @brief Mark every window to be drawn on the next frame
+             * */
+            void markAllDirty () {
+                for ( auto it = windows.begin(); it != windows.end(); it++ )
+                    it->second->dirty = true;
+            }
+
+            /**
+             * @brief returns true if a window is marked to be drawn on the next frame
+             * */
+            bool isDirty ( Uint32 windowId ) {
                 auto it = windows.find(windowId);
-                if (it != windows.end()) {
-                    return it->second->getRenderer();
-                }
-                return nullptr;
+                return it != windows.end() && it->second->dirty;
             }
 
             /**
-             * @brief Load an sdl texture from a png file
+             * @brief Decide if a window is drawn this frame
+             *
+             * Called by LE_Game::render for each window before drawing.
+             * Clears the dirty mark of the window.
              *
              * @param windowId
-             * @param filePath PNG file path
-             * @param textureId the generated texture will be refferenced by it
+             * @return true if the window is dirty or dirty tracking is disabled
              * */
-            void loadTexture ( Uint32 windowId,
-                    std::string filePath,
-                    std::string textureId );
+            bool beginRedraw ( Uint32 windowId ) {
+                auto it = windows.find(windowId);
+                if ( it == windows.end() ) return false;
+
+                LE_Window* window = it->second;
+
+                // Cameras are moved through their members
+                for ( LE_Camera* cam : window->cameras ) {
+                    if ( cam->changed() ) window->dirty = true;
+                }
+
+                window->redraw = !dirtyTracking || window->dirty;
+                window->dirty = false;
+                return window->redraw;
+            }
 
             /**
-             * @brief Add a texture from an existing SDL_Texture  object
+             * @brief Add a camera to a window
+             *
+             * Once a window has cameras, LE_Game::render draws the scene
+             * once per camera, each into its viewport. Draws are then made
+             * in world coordinates, and culled against the part of the world
+             * each camera sees. Draws into render targets and cached layers
+             * are not affected by cameras, but cached layers are drawn
+             * through them.
+             *
+             * The camera is owned by the window, move it by changing its
+             * members:
+             *
+             * @code
+             * LE_Camera* camera = LE_TEXTURE->addCamera ( mainWindow, "main" );
+             * camera->x = player->x;
+             * camera->zoom = 2;
+             * @endcode
              *
              * @param windowId
-             * @param textureId the texture will be accessible by this Id
-             * @param nT SDL_Texture* object
+             * @param cameraId
+             * @return the camera, nullptr if the window doesn't exist. If the
+             * id is in use, the existing camera is returned
              * */
-            void addTexture ( Uint32 windowId, std::string textureId, SDL_Texture* nT ) {
-                auto it = windows.find( windowId );
-                if ( it != windows.end() ) {
-                    it->second->addTexture( textureId, nT );
-                }
-            }
+            LE_Camera* addCamera ( Uint32 windowId, std::string cameraId );
 
-            void getTextureSize ( Uint32 windowId, std::string textureId,
-                    int* height, int* width ) {
-                auto it = windows.find(windowId);
-                if (it == windows.end()) {
-                    *height = *width = -1;
-                    return;
-                }
+            /**
+             * @brief Get a camera of a window
+             *
+             * @return nullptr if it doesn't exist
+             * */
+            LE_Camera* getCamera ( Uint32 windowId, const std::string& cameraId );
 
-                SDL_Texture* texture = it->second->getTexture(textureId);
-                if (texture != NULL)
-                    SDL_QueryTexture ( texture, NULL, NULL, width, height );
+            /**
+             * @brief Remove and delete a camera from a window
+             *
+             * @param windowId
+             * @param cameraId
+             * */
+            void popCamera ( Uint32 windowId, const std::string& cameraId );
 
-                return;
+            /**
+             * @brief Number of cameras of a window
+             * */
+            int getCameraCount ( Uint32 windowId ) {
+                auto it = windows.find(windowId);
+                if ( it == windows.end() ) return 0;
+                return it->second->cameras.size();
             }
 
             /**
-             * @brief Remove a texture by it's ID
+             * @brief Make draws into a window go through one of its cameras
+             *
+             * Called by LE_Game::render before drawing the scene for each
+             * camera. Sets the camera viewport, and drops every draw into
+             * the window if it has no camera for that index (a window
+             * without cameras is only drawn on pass 0, untransformed).
              *
              * @param windowId
-             * @param textureId
+             * @param index camera index, in creation order
+             * @return false if the window isn't drawn in this pass
              * */
-            void popTexture ( Uint32 windowId, std::string textureId ) {
-                auto it = windows.find( windowId );
-                if ( it != windows.end() ) {
-                    it->second->popTexture( textureId );
-                }
-            }
+            bool beginCameraPass ( Uint32 windowId, int index );
 
             /**
-             * @brief add a Tile from existing LE_Tile object
+             * @brief Get the part of the world drawn into a window in the
+             * current camera pass
+             *
+             * The world view of the pass camera, or the whole window if it
+             * has no cameras.
              *
              * @param windowId
-             * @param tileId Id for the new tile
-             * @param newTile LE_Tile object to add
+             * @param area gets the area, in the coordinates draws are made
+             * @param camera gets the pass camera, nullptr without cameras;
+             * may be nullptr
+             * @return false if the window isn't drawn in this pass
              * */
-            void addTile ( Uint32 windowId, std::string tileId, LE_Tile* newTile ) {
-                auto it = windows.find( windowId );
-                if ( it == windows.end() ) {
-                    std::cerr << "Error adding tile: window id " << windowId <<
-                        " doesn't exist" << std::endl;
-                    return;
+            bool getPassView ( Uint32 windowId, SDL_Rect* area, LE_Camera** camera = nullptr ) {
+                auto it = windows.find(windowId);
+                if ( it == windows.end() || it->second->skipPass ) return false;
+
+                LE_Window* window = it->second;
+                if ( camera != nullptr ) *camera = window->camera;
+                if ( window->camera != nullptr ) {
+                    *area = window->camera->worldView();
+                } else {
+                    *area = { 0, 0, 0, 0 };
+                    SDL_GetRendererOutputSize ( window->sdl_renderer, &area->w, &area->h );
                 }
-                it->second->addTile ( tileId, newTile );
+                return true;
             }
 
             /**
-             * @brief Adds a tile to the tile map
-             *
-             * if h or w are entered as 0, the tile will
-             * match the texture size
+             * @brief Finish a camera pass, draws are made in window
+             * coordinates again
              *
              * @param windowId
-             * @param textureId
-             * @param tileId
-             * @param x tile x coord
-             * @param y tile y coord
-             * @param h tile height
-             * @param w tile width
              * */
-            void createTile ( Uint32 windowId,
-                    std::string textureId,
-                    std::string tileId,
-                    int x = 0, int y = 0, int h = 0, int w = 0 );
+            void endCameraPass ( Uint32 windowId );
 
             /**
-             * @brief Delete tile by Id
+             * @brief Set the position of the current render target texture
+             * in window coordinates
+             *
+             * Draws into the target are moved by -x, -y, so a part of the
+             * window can be drawn into a texture without moving each draw.
+             * Reset by restoreRenderTarget.
              *
              * @param windowId
-             * @param tileId
+             * @param x
+             * @param y
              * */
-            void popTile ( Uint32 windowId, std::string tileId ) {
-                auto it = windows.find( windowId );
-                if ( it != windows.end() ) {
-                    it->second->popTile( tileId );
-                }
+            void setTargetOrigin ( Uint32 windowId, int x, int y ) {
+                auto it = windows.find(windowId);
+                if ( it == windows.end() ) return;
+                flushBatch ( it->second );
+                it->second->targetOrigin = { x, y };
+                it->second->viewValid = false;
             }
 
             /**
-             * @brief Chekc if sdl is initialized
+             * @brief Start drawing a cached layer, if it needs to be drawn
              *
-             * @return true sdl is initialized
+             * Cached layers keep a set of draws that rarely change (a tile
+             * map, static objects, a UI panel) in a target texture, so they
+             * are drawn once and then copied into the window with a single
+             * draw each frame, until invalidated:
+             *
+             * @code
+             * if ( LE_TEXTURE->beginCachedLayer ( mainWindow, "background", 0, 0, 480, 640 ) ) {
+             *     // draw the background as usual
+             * }
+             * LE_TEXTURE->endCachedLayer ( mainWindow, "background" );
+             * @endcode
+             *
+             * When this returns true, every draw into the window until
+             * endCachedLayer goes into the layer texture. Coordinates stay
+             * in window coordinates and draws outside the area are lost.
+             * Those draws skip the render queue, they are drawn in the order
+             * they are made.
+             *
+             * If the layer texture can't be created (an area bigger than the
+             * renderer supports...), this returns true on every call and
+             * the draws go to the window as if the layer wasn't cached.
+             *
+             * The layer is drawn again if its area changes. Target textures
+             * come from a pool per window, so layers popped or resized
+             * don't create new textures when another layer of that size is
+             * needed.
+             *
+             * Layers can't be nested. Cached layers are created on their
+             * first call, and their ids are shared by every user of the
+             * window.
+             *
+             * @param windowId
+             * @param layerId
+             * @param x area left position, in window coordinates
+             * @param y area top position, in window coordinates
+             * @param h area height
+             * @param w area width
+             * @return true if the draws of the layer must be made now
              * */
-            bool SDLWasInit () { return sdl_initialized; }
+            bool beginCachedLayer ( Uint32 windowId, const std::string& layerId,
+                    int x, int y, int h, int w );
 
             /**
-             * @brief Chekc if sdl_image is initialized
+             * @brief Finish drawing a cached layer and draw it into the window
              *
-             * @return true sdl_image is initialized
+             * Must be called after each call to beginCachedLayer, whatever
+             * it returned.
+             *
+             * @param windowId
+             * @param layerId
+             * @param layer draw layer of the whole cached layer in the render queue
+             * @param z order inside the draw layer
              * */
-            bool ImageWasInit () { return sdl_image_initialized; }
+            void endCachedLayer ( Uint32 windowId, const std::string& layerId,
+                    int layer = 0, int z = 0 );
 
             /**
-             * @brief Chekc if sdl_ttf is initialized
+             * @brief Draw a cached layer again on its next use
              *
-             * @return true sdl_ttf is initialized
+             * Call it when something drawn into the layer changes.
+             *
+             * @param windowId
+             * @param layerId
              * */
-            bool TTFWasInit () { return sdl_ttf_initialized; }
+            void invalidateCachedLayer ( Uint32 windowId, const std::string& layerId ) {
+                auto it = windows.find ( windowId );
+                if ( it == windows.end() ) return;
+
+                auto layer = it->second->cachedLayers.find ( layerId );
+                if ( layer != it->second->cachedLayers.end() ) {
+                    layer->second.valid = false;
+                    it->second->dirty = true;
+                }
+            }
 
             /**
-             * @brief Check if all sdl subsystems were initialized
+             * @brief Move the area of a cached layer without drawing it again
              *
-             * @return true if all subsystems were initialized
+             * For layers whose draws all moved by the same amount, like a
+             * scrolling tile map. Does nothing if the layer doesn't exist.
+             *
+             * @param windowId
+             * @param layerId
+             * @param x new area left position, in window coordinates
+             * @param y new area top position, in window coordinates
              * */
-            bool EverythingWasInit() {
-                return ( sdl_initialized && sdl_image_initialized && sdl_ttf_initialized );
+            void moveCachedLayer ( Uint32 windowId, const std::string& layerId, int x, int y ) {
+                auto it = windows.find ( windowId );
+                if ( it == windows.end() ) return;
+
+                auto layer = it->second->cachedLayers.find ( layerId );
+                if ( layer == it->second->cachedLayers.end() ) return;
+                if ( layer->second.area.x != x || layer->second.area.y != y ) {
+                    layer->second.area.x = x;
+                    layer->second.area.y = y;
+                    it->second->dirty = true;
+                }
             }
 
             /**
-             * @brief Returns the LE_TextureManager instance
+             * @brief Draw every cached layer again on its next use
+             *
+             * Called when the renderer loses the contents of its targets
+             * (SDL_RENDER_TARGETS_RESET)
              * */
-            static LE_TextureManager* Instance () {
-                if ( tm_instance == nullptr ) {
-                    tm_instance = new LE_TextureManager ();
+            void invalidateCachedLayers () {
+                for ( auto it = windows.begin(); it != windows.end(); it++ ) {
+                    for ( auto& layer : it->second->cachedLayers )
+                        layer.second.valid = false;
+                    it->second->dirty = true;
                 }
-                return tm_instance;
             }
 
             /**
-             * @brief Destroy LE_TextureManager instance
+             * @brief Remove a cached layer, its texture goes back to the pool
              *
-             * called inside LE_Quit()
+             * @param windowId
+             * @param layerId
              * */
-            static void destroyInstance () {
-                if ( tm_instance != nullptr ) {
-                    delete tm_instance;
-                    tm_instance = nullptr;
-                }
+            void popCachedLayer ( Uint32 windowId, const std::string& layerId );
+
+            /**
+             * @brief Enable or disable view culling
+             *
+             * While enabled, LE_TextureManager::draw skips sprites which
+             * bounding box (rotation included) is completely outside of the
+             * window, or of the render target being drawn into. Skipped
+             * sprites are counted in LE_RenderStats::culled.
+             *
+             * Enabled by default
+             *
+             * @param enabled
+             * */
+            void setCulling ( bool enabled ) { culling = enabled; }
+
+            /**
+             * @brief returns true if view culling is enabled
+             * */
+            bool isCulling () { return culling; }
+
+            /**
+             * @brief Get the area of a window draws are culled against
+             *
+             * In world coordinates, the area seen by the camera of the
+             * current pass, or the size of the window or of the render
+             * target being drawn into.
+             *
+             * @param windowId
+             * @param rect where to save the view
+             * @return false if the window doesn't exist
+             * */
+            bool getViewRect ( Uint32 windowId, SDL_Rect* rect ) {
+                auto it = windows.find(windowId);
+                if ( it == windows.end() ) return false;
+                *rect = windowView ( it->second );
+                return true;
             }
 
             /**
-             * @brief Fill background with a plain rgb color
+             * @brief Count draws culled outside of LE_TextureManager::draw
+             *
+             * For callers doing their own culling, like LE_TileMap, so
+             * LE_RenderStats::culled stays meaningful.
              * */
-            bool fillBackground ( Uint32 windowId, Uint8 r, Uint8 g, Uint8 b, Uint8 a ) {
-                auto it = windows.find( windowId );
-                if ( it != windows.end() ) {
-                    LE_Window* leText = it->second;
-                    SDL_SetRenderDrawColor ( leText->getRenderer(), r, g, b, a );
-                    SDL_RenderClear ( leText->getRenderer() );
-                    return true;
-                }
-                // Window for this id does not exist
-                return false;
+            void addCulledDraws ( Uint32 count ) { stats.culled += count; }
+
+            /**
+             * @brief Version of what a tile handle draws
+             *
+             * Changes when the tile or the texture of the handle are
+             * modified, removed or added, but not when the texture is
+             * evicted and loaded again, useful to know when tile sizes or
+             * something drawn with the handle are outdated.
+             *
+             * @param tileHandle handle returned by LE_TextureManager::resolveTile
+             * @return 0 for invalid handles
+             * */
+            Uint32 getTileVersion ( LE_TileHandle tileHandle ) {
+                std::lock_guard<std::mutex> lock ( handleMutex );
+                return tileHandle < tileHandles.size() ? tileHandles[tileHandle].version : 0;
             }
 
             /**
-             * @brief Renders all elements that have been drawn onto the window
+             * @brief Draw every sprite queued or batched for a window
              *
              * @param windowId
              * */
-            bool present ( Uint32 windowId ) {
+            void flush ( Uint32 windowId ) {
                 auto it = windows.find(windowId);
                 if ( it != windows.end() ) {
-                    SDL_RenderPresent ( it->second->getRenderer() );
-                    return true;
+                    flushWindow ( it->second );
                 }
-                return false;
             }
 
             /**
-             * @brief draw a tile
+             * @brief Marks the start of a new frame
              *
-             * The tile is only drawn into the window corresponding to
-             * the windowId inserted and also, the textureId referenced
-             * into that tile must exist in that window sdl_textures map
+             * Saves the counters of the frame that just ended, called by
+             * LE_Game::render before anything is drawn.
+             * */
+            void beginFrame () {
+                lastStats = stats;
+                stats = { 0, 0, 0, 0 };
+
+                // Windows may have been resized
+                for ( auto it = windows.begin(); it != windows.end(); it++ )
+                    it->second->viewValid = false;
+                frameCount++;
+            }
+
+            /**
+             * @brief Get rendering counters of the last complete frame
+             * */
+            const LE_RenderStats& getRenderStats () { return lastStats; }
+
+            /**
+             * @brief Limit the texture memory of a window
              *
-             * Note: in order to the tiles drawn to be shown in a window,
-             * call LE_TextureManager::present(windowId)
+             * Textures loaded from image files are counted (bytes per pixel
+             * times width times height) and, when a window goes over its
+             * budget, the least recently drawn ones are destroyed along with
+             * their decoded image. They are loaded again from their file on
+             * their next draw, keeping their blend mode and color modulation.
+             * Textures drawn in the current frame, render targets and
+             * textures added with addTexture are never evicted, but count
+             * towards the budget.
              *
              * @param windowId
-             * @param tileId
-             * @param x coord to draw the tile into the window
-             * @param y coord to draw the tile into the window
-             * @param h if scale is set to true, works a a multipier for the actual tile height, it works as an absolute height modifier.
-             * @param w if scale is set to true, works a a multipier for the actual tile width, it works as an absolute width modifier.
-             * @param scale set to false to set h and w as absolute size modifier
-             * @param flipv flip the image vertically
-             * @param fliph flip the image horizontally
-             * @param angle
-             * @return true if the draw was completed without error
+             * @param bytes texture memory budget, 0 for no limit (default)
              * */
-            bool draw ( Uint32 windowId, std::string tileId,
-                        int x, int y, double h = 1, double w = 1,
-                        bool scale = true, bool flipv = false,
-                        bool fliph = false, const double angle = 0 );
+            void setTextureBudget ( Uint32 windowId, Uint64 bytes ) {
+                auto it = windows.find ( windowId );
+                if ( it == windows.end() ) {
+                    std::cerr << "Could not set texture budget: window id "
+                        << windowId << " doesn't exist" << std::endl;
+                    return;
+                }
+                it->second->textureBudget = bytes;
+                checkBudget ( it->second );
+            }
+
+            /**
+             * @brief Get the texture memory budget of a window, 0 if unlimited
+             * */
+            Uint64 getTextureBudget ( Uint32 windowId ) {
+                auto it = windows.find ( windowId );
+                return it != windows.end() ? it->second->textureBudget : 0;
+            }
+
+            /**
+             * @brief Get the memory used by the textures of a window in bytes
+             * */
+            Uint64 getTextureMemory ( Uint32 windowId ) {
+                auto it = windows.find ( windowId );
+                return it != windows.end() ? it->second->textureBytes : 0;
+            }
+
+            /**
+             * @brief Get the decoded images shared by every window
+             * */
+            LE_ImageCache* getImageCache () { return &imageCache; }
+
+            /**
+             * @brief Set the size of the atlas pages
+             *
+             * Pages are square, and never larger than the maximum texture
+             * size supported by the window renderer. Default is 2048.
+             *
+             * @param size page width and height in pixels
+             * */
+            void setAtlasPageSize ( int size ) {
+                if ( size <= 0 ) {
+                    std::cerr << "Invalid atlas page size: " << size << std::endl;
+                    return;
+                }
+                atlasPageSize = size;
+            }
+
+            /**
+             * @brief Get the size of the atlas pages
+             * */
+            int getAtlasPageSize () { return atlasPageSize; }
 
             /**
              * @brief change draw target to an empty texture
@@ -736,6 +2188,7 @@
                 if ( it == windows.end() ) {
                     return;
                 }
+                flushBatch ( it->second );
 
                 SDL_Texture* targetTexture = SDL_CreateTexture (
                         it->second->getRenderer(),
@@ -747,6 +2200,9 @@
                 SDL_SetTextureBlendMode(targetTexture, SDL_BLENDMODE_BLEND);
 
                 SDL_SetRenderTarget ( it->second->getRenderer(), targetTexture );
+                it->second->onTarget = true;
+                it->second->targetOrigin = { 0, 0 };
+                it->second->viewValid = false;
                 SDL_SetRenderDrawColor(it->second->getRenderer(), 0, 0, 0, 0);
                 SDL_RenderClear(it->second->getRenderer());
             }
@@ -763,9 +2219,13 @@
             void setRenderTarget ( Uint32 windowId, std::string textureId ) {
                 auto it = windows.find ( windowId );
                 if ( it == windows.end() ) return;
+                flushBatch ( it->second );
 
                 SDL_SetRenderTarget ( it->second->getRenderer(),
                         it->second->getTexture( textureId ) );
+                it->second->onTarget = true;
+                it->second->targetOrigin = { 0, 0 };
+                it->second->viewValid = false;
             }
 
             /**
@@ -776,8 +2236,13 @@
             void restoreRenderTarget ( Uint32 windowId ) {
                 auto it = windows.find ( windowId );
                 if ( it == windows.end() ) return;
+                flushBatch ( it->second );
 
+                // SDL restores the viewport of the current camera
                 SDL_SetRenderTarget ( it->second->getRenderer(), NULL );
+                it->second->onTarget = false;
+                it->second->targetOrigin = { 0, 0 };
+                it->second->viewValid = false;
             }
 
             /**
@@ -788,7 +2253,8 @@
              * applied, the blend mode is applied to the renderer, use
              * LE_BlendMode::none to restore it.
              * @param textureId optional; if set, the blendmode is only applied
-             * for this texture
+             * for this texture. Draws of the texture still in the render
+             * queue are drawn with the new blend mode.
              * */
             void setBlendMode ( LE_BlendMode blendMode,
                     Uint32 windowId,
@@ -815,8 +2281,9 @@
                         << " Tile ID  Doesn't exist." << std::endl;
                     return;
                 }
-                if ( h != nullptr ) *h = it2->second->h;
-                if ( w != nullptr ) *w = it2->second->w;
+                // Trimmed atlas tiles keep their original size
+                if ( h != nullptr ) *h = it2->second->full_h;
+                if ( w != nullptr ) *w = it2->second->full_w;
             }
 
             /**
@@ -824,6 +2291,7 @@
              *
              * @param filePath path to xml file
              * @param windowId
+             * @param atlas when true every texture of the file is packed into atlas pages
              *
              * XML file format:
              * @code
@@ -838,8 +2306,41 @@
              *   </texture>
              * </TILESETS>
              * @endcode
+             *
+             * Textures with an atlas attribute (it can also be set on TILESETS)
+             * are packed into atlas pages instead of being loaded on their own:
+             * tiles are trimmed of transparent borders and textures sharing the
+             * same atlas name share pages, named "<atlas>#0", "<atlas>#1", ...
+             * Tiles keep their ids and sizes, so drawing them doesn't change,
+             * but the original texture ids are not created.
+             *
+             * @code
+             * <TILESETS atlas="ui">
+             *   <texture id="buttons" filepath="path/to/buttons.png">
+             *       <set tile="ok" x="0" y="0" h="24" w="64"/>
+             *   </texture>
+             * </TILESETS>
+             * @endcode
+             *
+             * @see LE_TextureManager::setAtlasPageSize
+             * */
+            void loadFromXmlFile ( std::string filePath, Uint32 windowId, bool atlas = false );
+
+            /**
+             * @brief load Textures and tiles from xml file without blocking
+             *
+             * Same file format as loadFromXmlFile. The file is read right
+             * away, textures are loaded with loadTextureAsync and each tile
+             * is created once its texture exists. Atlas attributes are
+             * ignored, every texture is loaded on its own.
+             *
+             * @param filePath path to xml file
+             * @param windowId
+             * @param onDone called on the main thread once every texture was
+             * processed, with false if any of them failed to load
              * */
-            void loadFromXmlFile ( std::string filePath, Uint32 windowId );
+            void loadFromXmlFileAsync ( std::string filePath, Uint32 windowId,
+                    LE_LoadCallback onDone = nullptr );
     };
 
 #endif
@@ -0,0 +1,304 @@
+#include "lambda_Atlas.h"
+#include "lambda_TextureManager.h"
+#include <algorithm>
+#include <iostream>
+
+using namespace std;
+
+LE_AtlasPacker::LE_AtlasPacker ( int m_width, int m_height ):
+    width(m_width), height(m_height) {
+    skyline.push_back ( { 0, 0, m_width } );
+}
+
+int LE_AtlasPacker::fitAt ( int idx, int w, int h ) {
+    int x = skyline[idx].x;
+    if ( x + w > width ) return -1;
+
+    int y = skyline[idx].y;
+    int widthLeft = w;
+
+    for ( int i = idx; widthLeft > 0; i++ ) {
+        if ( i >= (int)skyline.size() ) return -1;
+        y = max ( y, skyline[i].y );
+        if ( y + h > height ) return -1;
+        widthLeft -= skyline[i].w;
+    }
+    return y;
+}
+
+bool LE_AtlasPacker::insert ( int w, int h, int* x, int* y ) {
+    int best = -1, bestTop = 0, bestWidth = 0, bestY = 0;
+
+    for ( int i = 0; i < (int)skyline.size(); i++ ) {
+        int fitY = fitAt ( i, w, h );
+        if ( fitY < 0 ) continue;
+
+        // Lowest top edge first, then the narrowest segment
+        if ( best < 0 || fitY + h < bestTop ||
+             ( fitY + h == bestTop && skyline[i].w < bestWidth ) ) {
+            best = i;
+            bestTop = fitY + h;
+            bestWidth = skyline[i].w;
+            bestY = fitY;
+        }
+    }
+    if ( best < 0 ) return false;
+
+    *x = skyline[best].x;
+    *y = bestY;
+
+    skyline.insert ( skyline.begin() + best, { *x, bestY + h, w } );
+
+    // Shrink or remove the segments now covered by the new one
+    for ( int i = best + 1; i < (int)skyline.size(); ) {
+        SkylineNode& prev = skyline[i-1];
+        int overlap = prev.x + prev.w - skyline[i].x;
+        if ( overlap <= 0 ) break;
+
+        skyline[i].x += overlap;
+        skyline[i].w -= overlap;
+        if ( skyline[i].w > 0 ) break;
+        skyline.erase ( skyline.begin() + i );
+    }
+
+    // Merge neighbours at the same height
+    for ( int i = 0; i + 1 < (int)skyline.size(); ) {
+        if ( skyline[i].y == skyline[i+1].y ) {
+            skyline[i].w += skyline[i+1].w;
+            skyline.erase ( skyline.begin() + i + 1 );
+        } else {
+            i++;
+        }
+    }
+    return true;
+}
+
+LE_AtlasBuilder::~LE_AtlasBuilder () {
+    for ( auto it = images.begin(); it != images.end(); it++ ) {
+        if ( it->second.surface != nullptr )
+            SDL_FreeSurface ( it->second.surface );
+    }
+    images.clear();
+}
+
+void LE_AtlasBuilder::addImage ( std::string textureId, std::string filePath, std::string group ) {
+    if ( hasImage ( textureId ) ) {
+        cerr << "The texture ID: " << textureId << " is already in use"
+            << " in atlas " << group << endl;
+        return;
+    }
+    images[textureId] = { filePath, group, nullptr };
+}
+
+void LE_AtlasBuilder::addTile ( std::string textureId, std::string tileId,
+        int x, int y, int h, int w ) {
+    AtlasTile tile;
+    tile.tileId = tileId;
+    tile.textureId = textureId;
+    tile.rect = { x, y, w, h };
+    tile.full = ( h == 0 || w == 0 );
+    tiles.push_back ( tile );
+}
+
+void LE_AtlasBuilder::build ( Uint32 windowId ) {
+    SDL_Renderer* renderer = LE_TEXTURE->getRenderer ( windowId );
+    if ( renderer == nullptr ) {
+        cerr << "Error building atlas: window id " << windowId <<
+            " doesn't exist" << endl;
+        return;
+    }
+
+    // Pages can't be larger than what the renderer supports
+    int pageSize = LE_TEXTURE->getAtlasPageSize();
+    SDL_RendererInfo info;
+    if ( SDL_GetRendererInfo ( renderer, &info ) == 0 ) {
+        if ( info.max_texture_width > 0 ) pageSize = min ( pageSize, info.max_texture_width );
+        if ( info.max_texture_height > 0 ) pageSize = min ( pageSize, info.max_texture_height );
+    }
+
+    // Decode every image as RGBA32 so alpha can be read directly,
+    // images already loaded by any window aren't decoded again
+    LE_ImageCache* cache = LE_TEXTURE->getImageCache();
+    for ( auto it = images.begin(); it != images.end(); it++ ) {
+        SDL_Surface* loaded = cache->acquire ( it->second.filePath );
+        if ( loaded == nullptr ) continue;
+
+        it->second.surface = SDL_ConvertSurfaceFormat ( loaded, SDL_PIXELFORMAT_RGBA32, 0 );
+        cache->release ( it->second.filePath );
+        if ( it->second.surface == nullptr ) {
+            cerr << "Error converting image " << it->second.filePath << ": "
+                << SDL_GetError() << endl;
+        }
+    }
+
+    map<string, vector<AtlasTile*>> groups;
+    for ( AtlasTile& tile : tiles ) {
+        auto img = images.find ( tile.textureId );
+        if ( img == images.end() || img->second.surface == nullptr ) continue;
+        groups[img->second.group].push_back ( &tile );
+    }
+
+    for ( auto it = groups.begin(); it != groups.end(); it++ ) {
+        buildGroup ( windowId, it->first, it->second, pageSize );
+    }
+}
+
+void LE_AtlasBuilder::buildGroup ( Uint32 windowId, const std::string& group,
+        const std::vector<AtlasTile*>& groupTiles, int pageSize ) {
+
+    // A region of an image, trimmed and placed in a page
+    typedef struct Packed {
+        SDL_Surface* surface;
+        SDL_Rect rect;
+        int trim_x, trim_y, full_h, full_w;
+        int page, x, y;
+    } Packed;
+
+    vector<Packed> packed;
+    vector<int> tilePacked;
+    map<string, int> regions;
+
+    for ( AtlasTile* tile : groupTiles ) {
+        SDL_Surface* surface = images[tile->textureId].surface;
+
+        SDL_Rect rect = tile->rect;
+        if ( tile->full ) rect = { 0, 0, surface->w, surface->h };
+
+        // Keep the region inside the image
+        int x0 = max ( rect.x, 0 ), y0 = max ( rect.y, 0 );
+        int x1 = min ( rect.x + rect.w, surface->w ), y1 = min ( rect.y + rect.h, surface->h );
+
+        // Tiles with the same region share their pixels
+        string key = tile->textureId + ":" + to_string(rect.x) + "," + to_string(rect.y)
+            + "," + to_string(rect.w) + "," + to_string(rect.h);
+        auto found = regions.find ( key );
+        if ( found != regions.end() ) {
+            tilePacked.push_back ( found->second );
+            continue;
+        }
+
+        // Trim transparent borders
+        int minX = x1, minY = y1, maxX = x0 - 1, maxY = y0 - 1;
+
+        if ( SDL_MUSTLOCK ( surface ) ) SDL_LockSurface ( surface );
+        for ( int y = y0; y < y1; y++ ) {
+            Uint8* row = (Uint8*)surface->pixels + y * surface->pitch;
+            for ( int x = x0; x < x1; x++ ) {
+                if ( row[x * 4 + 3] != 0 ) {
+                    if ( x < minX ) minX = x;
+                    if ( x > maxX ) maxX = x;
+                    if ( y < minY ) minY = y;
+                    if ( y > maxY ) maxY = y;
+                }
+            }
+        }
+        if ( SDL_MUSTLOCK ( surface ) ) SDL_UnlockSurface ( surface );
+
+        // Fully transparent tiles keep a single transparent pixel
+        if ( maxX < minX || maxY < minY ) {
+            minX = maxX = min ( max ( rect.x, 0 ), surface->w - 1 );
+            minY = maxY = min ( max ( rect.y, 0 ), surface->h - 1 );
+        }
+
+        Packed p;
+        p.surface = surface;
+        p.rect = { minX, minY, maxX - minX + 1, maxY - minY + 1 };
+        p.trim_x = minX - rect.x;
+        p.trim_y = minY - rect.y;
+        p.full_w = rect.w;
+        p.full_h = rect.h;
+        p.page = -1;
+        p.x = p.y = 0;
+
+        regions[key] = packed.size();
+        tilePacked.push_back ( packed.size() );
+        packed.push_back ( p );
+    }
+
+    // Tallest regions first pack tighter on a skyline
+    vector<int> order;
+    for ( int i = 0; i < (int)packed.size(); i++ ) order.push_back ( i );
+    sort ( order.begin(), order.end(), [&packed]( int a, int b ) {
+        if ( packed[a].rect.h != packed[b].rect.h ) return packed[a].rect.h > packed[b].rect.h;
+        return packed[a].rect.w > packed[b].rect.w;
+    } );
+
+    vector<LE_AtlasPacker> packers;
+    vector<SDL_Point> pageExtents;
+
+    for ( int idx : order ) {
+        Packed& p = packed[idx];
+        int w = p.rect.w + padding, h = p.rect.h + padding;
+
+        for ( int page = 0; page < (int)packers.size() && p.page < 0; page++ ) {
+            if ( packers[page].insert ( w, h, &p.x, &p.y ) ) p.page = page;
+        }
+        if ( p.page < 0 ) {
+            packers.push_back ( LE_AtlasPacker ( pageSize, pageSize ) );
+            pageExtents.push_back ( { 0, 0 } );
+            if ( packers.back().insert ( w, h, &p.x, &p.y ) ) {
+                p.page = packers.size() - 1;
+            } else {
+                packers.pop_back();
+                pageExtents.pop_back();
+                cerr << "Error building atlas " << group << ": a "
+                    << p.rect.w << "x" << p.rect.h << " tile doesn't fit in a "
+                    << pageSize << "x" << pageSize << " page" << endl;
+                continue;
+            }
+        }
+        pageExtents[p.page].x = max ( pageExtents[p.page].x, p.x + p.rect.w );
+        pageExtents[p.page].y = max ( pageExtents[p.page].y, p.y + p.rect.h );
+    }
+
+    // Copy the regions into pages, only as large as they need to be
+    vector<SDL_Surface*> pages;
+    for ( SDL_Point extent : pageExtents ) {
+        SDL_Surface* page = SDL_CreateRGBSurfaceWithFormat ( 0, extent.x, extent.y,
+                32, SDL_PIXELFORMAT_RGBA32 );
+        if ( page == nullptr ) {
+            cerr << "Error creating atlas page for " << group << ": "
+                << SDL_GetError() << endl;
+        }
+        pages.push_back ( page );
+    }
+
+    for ( Packed& p : packed ) {
+        if ( p.page < 0 || pages[p.page] == nullptr ) continue;
+        SDL_Rect dst = { p.x, p.y, p.rect.w, p.rect.h };
+        SDL_SetSurfaceBlendMode ( p.surface, SDL_BLENDMODE_NONE );
+        SDL_BlitSurface ( p.surface, &p.rect, pages[p.page], &dst );
+    }
+
+    LE_TextureManager* tm = LE_TEXTURE;
+    SDL_Renderer* renderer = tm->getRenderer ( windowId );
+
+    for ( int i = 0; i < (int)pages.size(); i++ ) {
+        if ( pages[i] == nullptr ) continue;
+
+        SDL_Texture* texture = SDL_CreateTextureFromSurface ( renderer, pages[i] );
+        SDL_FreeSurface ( pages[i] );
+        if ( texture == nullptr ) {
+            cerr << "Error creating atlas page for " << group << ": "
+                << SDL_GetError() << endl;
+            pages[i] = nullptr;
+            continue;
+        }
+        SDL_SetTextureBlendMode ( texture, SDL_BLENDMODE_BLEND );
+        tm->addTexture ( windowId, group + "#" + to_string(i), texture );
+    }
+
+    for ( int i = 0; i < (int)groupTiles.size(); i++ ) {
+        Packed& p = packed[tilePacked[i]];
+        if ( p.page < 0 || pages[p.page] == nullptr ) continue;
+
+        LE_Tile* tile = new LE_Tile ( group + "#" + to_string(p.page),
+                p.x, p.y, p.rect.h, p.rect.w );
+        tile->trim_x = p.trim_x;
+        tile->trim_y = p.trim_y;
+        tile->full_h = p.full_h;
+        tile->full_w = p.full_w;
+
+        tm->addTile ( windowId, groupTiles[i]->tileId, tile );
+    }
+}
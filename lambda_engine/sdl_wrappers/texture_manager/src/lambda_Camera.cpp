@@ -0,0 +1,63 @@
+#include "lambda_Camera.h"
+#include <algorithm>
+#include <cmath>
+
+void LE_Camera::update ( int w, int h ) {
+    double rad = angle * M_PI / 180.0;
+    cosAngle = std::cos ( rad );
+    sinAngle = std::sin ( rad );
+    viewW = w;
+    viewH = h;
+}
+
+bool LE_Camera::changed () {
+    if ( drawnX == x && drawnY == y && drawnZoom == zoom && drawnAngle == angle &&
+         drawnViewport.x == viewport.x && drawnViewport.y == viewport.y &&
+         drawnViewport.w == viewport.w && drawnViewport.h == viewport.h ) {
+        return false;
+    }
+
+    drawnX = x;
+    drawnY = y;
+    drawnZoom = zoom;
+    drawnAngle = angle;
+    drawnViewport = viewport;
+    return true;
+}
+
+void LE_Camera::toViewport ( double wx, double wy, double* vx, double* vy ) {
+    double dx = ( wx - x ) * zoom;
+    double dy = ( wy - y ) * zoom;
+
+    // Rotate the world against the camera
+    *vx = viewW / 2.0 + dx * cosAngle + dy * sinAngle;
+    *vy = viewH / 2.0 - dx * sinAngle + dy * cosAngle;
+}
+
+void LE_Camera::toWorld ( double vx, double vy, double* wx, double* wy ) {
+    double dx = vx - viewW / 2.0;
+    double dy = vy - viewH / 2.0;
+
+    *wx = x + ( dx * cosAngle - dy * sinAngle ) / zoom;
+    *wy = y + ( dx * sinAngle + dy * cosAngle ) / zoom;
+}
+
+SDL_Rect LE_Camera::worldView () {
+    double corners[4][2] = {
+        { 0, 0 }, { (double)viewW, 0 }, { 0, (double)viewH }, { (double)viewW, (double)viewH }
+    };
+
+    double left = 0, top = 0, right = 0, bottom = 0;
+    for ( int i = 0; i < 4; i++ ) {
+        double wx, wy;
+        toWorld ( corners[i][0], corners[i][1], &wx, &wy );
+        if ( i == 0 || wx < left ) left = wx;
+        if ( i == 0 || wx > right ) right = wx;
+        if ( i == 0 || wy < top ) top = wy;
+        if ( i == 0 || wy > bottom ) bottom = wy;
+    }
+
+    int x0 = (int)std::floor ( left );
+    int y0 = (int)std::floor ( top );
+    return { x0, y0, (int)std::ceil ( right ) - x0, (int)std::ceil ( bottom ) - y0 };
+}
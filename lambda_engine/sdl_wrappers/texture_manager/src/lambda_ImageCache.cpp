@@ -0,0 +1,51 @@
+#include "lambda_ImageCache.h"
+#include <SDL2/SDL_image.h>
+#include <iostream>
+
+using namespace std;
+
+SDL_Surface* LE_ImageCache::acquire ( const std::string& filePath, SDL_Surface* decoded ) {
+    auto it = images.find ( filePath );
+    if ( it != images.end() ) {
+        if ( decoded != nullptr && decoded != it->second.surface )
+            SDL_FreeSurface ( decoded );
+        it->second.refs++;
+        return it->second.surface;
+    }
+
+    if ( decoded == nullptr ) {
+        decoded = IMG_Load ( filePath.c_str() );
+        if ( decoded == nullptr ) {
+            cerr << "Error loading image " << filePath << ": " << IMG_GetError() << endl;
+            return nullptr;
+        }
+    }
+
+    images[filePath] = { decoded, 1 };
+    return decoded;
+}
+
+void LE_ImageCache::release ( const std::string& filePath ) {
+    auto it = images.find ( filePath );
+    if ( it == images.end() ) return;
+
+    if ( --it->second.refs <= 0 ) {
+        SDL_FreeSurface ( it->second.surface );
+        images.erase ( it );
+    }
+}
+
+Uint64 LE_ImageCache::bytes () {
+    Uint64 total = 0;
+    for ( auto it = images.begin(); it != images.end(); it++ ) {
+        total += (Uint64)it->second.surface->pitch * it->second.surface->h;
+    }
+    return total;
+}
+
+void LE_ImageCache::clear () {
+    for ( auto it = images.begin(); it != images.end(); it++ ) {
+        SDL_FreeSurface ( it->second.surface );
+    }
+    images.clear();
+}
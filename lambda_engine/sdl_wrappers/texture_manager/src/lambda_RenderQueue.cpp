@@ -0,0 +1,65 @@
+#include "lambda_RenderQueue.h"
+#include <algorithm>
+
+static Uint64 biased16 ( int value ) {
+    value = std::max ( -32768, std::min ( 32767, value ) );
+    return (Uint64)( value + 32768 );
+}
+
+static Uint64 blendIndex ( SDL_BlendMode blendMode ) {
+    switch ( blendMode ) {
+        case SDL_BLENDMODE_NONE:  return 0;
+        case SDL_BLENDMODE_BLEND: return 1;
+        case SDL_BLENDMODE_ADD:   return 2;
+        case SDL_BLENDMODE_MOD:   return 3;
+        case SDL_BLENDMODE_MUL:   return 4;
+        default:                  return 255;
+    }
+}
+
+Uint64 LE_RenderQueue::makeKey ( int layer, int z, Uint32 textureId, SDL_BlendMode blendMode ) {
+    return ( biased16 ( layer ) << 48 ) |
+           ( biased16 ( z ) << 32 ) |
+           ( (Uint64)( textureId & 0xFFFFFF ) << 8 ) |
+           blendIndex ( blendMode );
+}
+
+void LE_RenderQueue::push ( const LE_DrawCommand& cmd, int layer, int z ) {
+    auto it = textureIds.find ( cmd.texture );
+    if ( it == textureIds.end() ) {
+        it = textureIds.insert ( { cmd.texture, (Uint32)textureIds.size() } ).first;
+    }
+
+    items.push_back ( { makeKey ( layer, z, it->second, cmd.blendMode ),
+            (Uint32)commands.size() } );
+    commands.push_back ( cmd );
+}
+
+void LE_RenderQueue::sort () {
+    size_t n = items.size();
+    if ( n < 2 ) return;
+
+    scratch.resize ( n );
+
+    // LSD radix sort, 8 bits per pass, stable
+    for ( int shift = 0; shift < 64; shift += 8 ) {
+        size_t counts[256] = { 0 };
+        for ( const Item& item : items ) {
+            counts[( item.key >> shift ) & 0xFF]++;
+        }
+
+        // Every key has the same byte, nothing to reorder
+        if ( counts[( items[0].key >> shift ) & 0xFF] == n ) continue;
+
+        size_t offset = 0;
+        for ( int b = 0; b < 256; b++ ) {
+            size_t count = counts[b];
+            counts[b] = offset;
+            offset += count;
+        }
+        for ( const Item& item : items ) {
+            scratch[counts[( item.key >> shift ) & 0xFF]++] = item;
+        }
+        items.swap ( scratch );
+    }
+}
@@ -0,0 +1,85 @@
+#include "lambda_SpriteBatch.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+const int LE_SpriteBatch::maxQuads;
+
+int LE_SpriteBatch::push ( const LE_DrawCommand& cmd ) {
+    int drawCalls = 0;
+
+    if ( !vertices.empty() &&
+         ( cmd.texture != texture || cmd.blendMode != blendMode ||
+           vertices.size() >= 4 * (size_t)maxQuads ) ) {
+        drawCalls = flush();
+    }
+    texture = cmd.texture;
+    blendMode = cmd.blendMode;
+
+    // Texture coordinates, flips just swap them
+    float u0 = (float)cmd.src.x / cmd.texW;
+    float v0 = (float)cmd.src.y / cmd.texH;
+    float u1 = (float)( cmd.src.x + cmd.src.w ) / cmd.texW;
+    float v1 = (float)( cmd.src.y + cmd.src.h ) / cmd.texH;
+
+    if ( cmd.flip & SDL_FLIP_HORIZONTAL ) std::swap ( u0, u1 );
+    if ( cmd.flip & SDL_FLIP_VERTICAL ) std::swap ( v0, v1 );
+
+    // Corners relative to the rotation center, in clockwise order
+    float cx = cmd.dst.x + cmd.center.x;
+    float cy = cmd.dst.y + cmd.center.y;
+    float left = -cmd.center.x;
+    float top = -cmd.center.y;
+    float right = left + cmd.dst.w;
+    float bottom = top + cmd.dst.h;
+
+    float corners[4][2] = { { left, top }, { right, top }, { right, bottom }, { left, bottom } };
+    float uvs[4][2] = { { u0, v0 }, { u1, v0 }, { u1, v1 }, { u0, v1 } };
+
+    float c = 1, s = 0;
+    if ( cmd.angle != 0 ) {
+        double rad = cmd.angle * M_PI / 180.0;
+        c = std::cos ( rad );
+        s = std::sin ( rad );
+    }
+
+    for ( int i = 0; i < 4; i++ ) {
+        SDL_Vertex v;
+        v.position.x = cx + corners[i][0] * c - corners[i][1] * s;
+        v.position.y = cy + corners[i][0] * s + corners[i][1] * c;
+        v.color = cmd.color;
+        v.tex_coord.x = uvs[i][0];
+        v.tex_coord.y = uvs[i][1];
+        vertices.push_back ( v );
+    }
+
+    return drawCalls;
+}
+
+int LE_SpriteBatch::flush () {
+    if ( vertices.empty() ) return 0;
+
+    int quads = vertices.size() / 4;
+
+    // Indices are the same for every batch, just make sure there are enough
+    for ( int q = indices.size() / 6; q < quads; q++ ) {
+        int base = q * 4;
+        indices.push_back ( base );
+        indices.push_back ( base + 1 );
+        indices.push_back ( base + 2 );
+        indices.push_back ( base + 2 );
+        indices.push_back ( base + 3 );
+        indices.push_back ( base );
+    }
+
+    int drawCalls = 1;
+    if ( SDL_RenderGeometry ( renderer, texture, vertices.data(), vertices.size(),
+                indices.data(), quads * 6 ) < 0 ) {
+        std::cerr << "Error rendering sprite batch " << SDL_GetError() << std::endl;
+        drawCalls = 0;
+    }
+
+    vertices.clear();
+    texture = nullptr;
+    return drawCalls;
+}
@@ -0,0 +1,81 @@
+#include "lambda_TextureLoader.h"
+#include "lambda_Profiler.h"
+#include <SDL2/SDL_image.h>
+
+using namespace std;
+
+LE_TextureLoader::LE_TextureLoader ( int threads ): inFlight(0), stopping(false) {
+    if ( threads < 1 ) threads = 1;
+    for ( int i = 0; i < threads; i++ ) {
+        workers.push_back ( thread ( &LE_TextureLoader::workerLoop, this ) );
+    }
+}
+
+LE_TextureLoader::~LE_TextureLoader () {
+    {
+        lock_guard<std::mutex> lock ( mutex );
+        stopping = true;
+    }
+    wake.notify_all();
+    for ( thread& worker : workers ) worker.join();
+
+    for ( LE_LoadRequest* req : pending ) delete req;
+    for ( LE_LoadRequest* req : decoded ) {
+        if ( req->surface != nullptr ) SDL_FreeSurface ( req->surface );
+        delete req;
+    }
+}
+
+void LE_TextureLoader::workerLoop () {
+    while ( true ) {
+        LE_LoadRequest* req;
+        {
+            unique_lock<std::mutex> lock ( mutex );
+            wake.wait ( lock, [this]() { return stopping || !pending.empty(); } );
+            if ( stopping ) return;
+            req = pending.front();
+            pending.pop_front();
+        }
+
+        {
+            LE_PROFILE_SCOPE ( "decode image" );
+            req->surface = IMG_Load ( req->filePath.c_str() );
+            if ( req->surface == nullptr ) req->error = IMG_GetError();
+        }
+
+        lock_guard<std::mutex> lock ( mutex );
+        decoded.push_back ( req );
+    }
+}
+
+void LE_TextureLoader::push ( LE_LoadRequest* req ) {
+    req->surface = nullptr;
+    {
+        lock_guard<std::mutex> lock ( mutex );
+        pending.push_back ( req );
+        inFlight++;
+    }
+    wake.notify_one();
+}
+
+void LE_TextureLoader::complete ( LE_LoadRequest* req ) {
+    req->surface = nullptr;
+    lock_guard<std::mutex> lock ( mutex );
+    decoded.push_back ( req );
+    inFlight++;
+}
+
+LE_LoadRequest* LE_TextureLoader::pop () {
+    lock_guard<std::mutex> lock ( mutex );
+    if ( decoded.empty() ) return nullptr;
+
+    LE_LoadRequest* req = decoded.front();
+    decoded.pop_front();
+    inFlight--;
+    return req;
+}
+
+int LE_TextureLoader::count () {
+    lock_guard<std::mutex> lock ( mutex );
+    return inFlight;
+}
@@ -1,6 +1,10 @@
 #include "lambda_TextureManager.h"
+#include "lambda_Atlas.h"
 #include "lambda_XMLFabric.h"
 #include <lambda_config.h>
+#include <algorithm>
+#include <cmath>
+#include <memory>
 
 using namespace std;
 
@@ -14,16 +18,199 @@ void LE_Tile::query ( std::string* m_textureId, int* m_x, int* m_y, int* m_h, in
     if ( m_w != nullptr ) *m_w = w;
 }
 
+// Tiles may be shared by several windows
+void LE_Tile::set_x ( int m_x ) {
+    x = m_x;
+    LE_TEXTURE->invalidateTileHandles ( nullptr, nullptr, this );
+    LE_TEXTURE->markAllDirty();
+}
+void LE_Tile::set_y ( int m_y ) {
+    y = m_y;
+    LE_TEXTURE->invalidateTileHandles ( nullptr, nullptr, this );
+    LE_TEXTURE->markAllDirty();
+}
+void LE_Tile::set_h ( int m_h ) {
+    h = full_h = m_h;
+    trim_y = 0;
+    LE_TEXTURE->invalidateTileHandles ( nullptr, nullptr, this );
+    LE_TEXTURE->markAllDirty();
+}
+void LE_Tile::set_w ( int m_w ) {
+    w = full_w = m_w;
+    trim_x = 0;
+    LE_TEXTURE->invalidateTileHandles ( nullptr, nullptr, this );
+    LE_TEXTURE->markAllDirty();
+}
+
 void LE_Window::clean() {
+    batch.discard();
+    queue.clear();
+
     for ( auto it = sdl_textures.begin(); it != sdl_textures.end(); it++ ) {
-        SDL_DestroyTexture( it->second );
+        if ( it->second.texture != nullptr )
+            SDL_DestroyTexture( it->second.texture );
+        if ( it->second.imageHeld )
+            images->release ( it->second.filePath );
     }
     sdl_textures.clear();
+    textureBytes = 0;
 
     for ( auto it = tileSet.begin(); it != tileSet.end(); it++ ) {
         delete it->second;
     }
     tileSet.clear();
+
+    if ( building != nullptr ) {
+        SDL_SetRenderTarget ( sdl_renderer, buildingPrevTarget );
+        building = nullptr;
+        viewValid = false;
+    }
+    for ( auto it = cachedLayers.begin(); it != cachedLayers.end(); it++ ) {
+        if ( it->second.texture != nullptr )
+            SDL_DestroyTexture ( it->second.texture );
+    }
+    cachedLayers.clear();
+
+    for ( SDL_Texture* texture : targetPool ) SDL_DestroyTexture ( texture );
+    targetPool.clear();
+
+    for ( SDL_Texture* texture : retired ) SDL_DestroyTexture ( texture );
+    retired.clear();
+}
+
+SDL_Texture* LE_Window::acquireTarget ( int h, int w ) {
+    for ( size_t i = 0; i < targetPool.size(); i++ ) {
+        int tw, th;
+        SDL_QueryTexture ( targetPool[i], NULL, NULL, &tw, &th );
+        if ( tw == w && th == h ) {
+            SDL_Texture* texture = targetPool[i];
+            targetPool.erase ( targetPool.begin() + i );
+            return texture;
+        }
+    }
+
+    SDL_Texture* texture = SDL_CreateTexture ( sdl_renderer,
+            SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, w, h );
+    if ( texture == nullptr ) {
+        cerr << "Error creating cached layer texture: " << SDL_GetError() << endl;
+        return nullptr;
+    }
+    SDL_SetTextureBlendMode ( texture, SDL_BLENDMODE_BLEND );
+    return texture;
+}
+
+void LE_Window::releaseTarget ( SDL_Texture* texture ) {
+    // Keep a few spare targets, the oldest are destroyed first
+    const size_t maxPooled = 8;
+    if ( targetPool.size() >= maxPooled ) {
+        SDL_DestroyTexture ( targetPool.front() );
+        targetPool.erase ( targetPool.begin() );
+    }
+    targetPool.push_back ( texture );
+}
+
+LE_TextureEntry LE_Window::newEntry ( const std::string& filePath ) {
+    LE_TextureEntry entry;
+    entry.texture = nullptr;
+    entry.filePath = filePath;
+    entry.imageHeld = false;
+    entry.w = entry.h = 0;
+    entry.bytes = 0;
+    entry.lastUsed = 0;
+    entry.restoreState = false;
+    entry.blendMode = SDL_BLENDMODE_BLEND;
+    entry.color = { 255, 255, 255, 255 };
+    return entry;
+}
+
+Uint64 LE_Window::textureSize ( SDL_Texture* texture, int* h, int* w ) {
+    Uint32 format;
+    int tw, th;
+    if ( SDL_QueryTexture ( texture, &format, NULL, &tw, &th ) < 0 ) return 0;
+    if ( h != nullptr ) *h = th;
+    if ( w != nullptr ) *w = tw;
+    return (Uint64)SDL_BYTESPERPIXEL ( format ) * tw * th;
+}
+
+bool LE_Window::createTexture ( LE_TextureEntry& entry ) {
+    if ( entry.filePath.empty() ) return false;
+
+    // Evicted textures decode their image again, unless another window has it
+    if ( !entry.imageHeld ) {
+        if ( images->acquire ( entry.filePath ) == nullptr ) return false;
+        entry.imageHeld = true;
+    }
+
+    SDL_Surface* surface = images->get ( entry.filePath );
+    entry.texture = SDL_CreateTextureFromSurface ( sdl_renderer, surface );
+    if ( entry.texture == nullptr ) {
+        cerr << "Error creating texture from " << entry.filePath << ": "
+            << SDL_GetError() << endl;
+        return false;
+    }
+
+    if ( entry.restoreState ) {
+        SDL_SetTextureBlendMode ( entry.texture, entry.blendMode );
+        SDL_SetTextureColorMod ( entry.texture, entry.color.r, entry.color.g, entry.color.b );
+        SDL_SetTextureAlphaMod ( entry.texture, entry.color.a );
+    }
+
+    entry.bytes = textureSize ( entry.texture, &entry.h, &entry.w );
+    textureBytes += entry.bytes;
+    return true;
+}
+
+void LE_Window::evict ( LE_TextureEntry& entry ) {
+    if ( entry.texture == nullptr || entry.filePath.empty() ) return;
+
+    SDL_GetTextureBlendMode ( entry.texture, &entry.blendMode );
+    SDL_GetTextureColorMod ( entry.texture, &entry.color.r, &entry.color.g, &entry.color.b );
+    SDL_GetTextureAlphaMod ( entry.texture, &entry.color.a );
+    entry.restoreState = true;
+
+    SDL_DestroyTexture ( entry.texture );
+    entry.texture = nullptr;
+    textureBytes -= entry.bytes;
+    entry.bytes = 0;
+
+    if ( entry.imageHeld ) {
+        images->release ( entry.filePath );
+        entry.imageHeld = false;
+    }
+}
+
+int LE_Window::evictUntilUnderBudget ( Uint32 currentFrame ) {
+    std::vector<LE_TextureEntry*> candidates;
+    for ( auto it = sdl_textures.begin(); it != sdl_textures.end(); it++ ) {
+        LE_TextureEntry& entry = it->second;
+        if ( entry.texture != nullptr && !entry.filePath.empty() &&
+             entry.lastUsed != currentFrame ) {
+            candidates.push_back ( &entry );
+        }
+    }
+
+    // Least recently drawn first
+    std::sort ( candidates.begin(), candidates.end(),
+            []( const LE_TextureEntry* a, const LE_TextureEntry* b ) {
+                return a->lastUsed < b->lastUsed;
+            } );
+
+    int evicted = 0;
+    for ( LE_TextureEntry* entry : candidates ) {
+        if ( !overBudget() ) break;
+        evict ( *entry );
+        evicted++;
+    }
+    return evicted;
+}
+
+bool LE_Window::getTextureSize ( const std::string& textureId, int* h, int* w ) {
+    auto it = sdl_textures.find(textureId);
+    if ( it == sdl_textures.end() ) return false;
+
+    if ( h != nullptr ) *h = it->second.h;
+    if ( w != nullptr ) *w = it->second.w;
+    return true;
 }
 
 void LE_TextureManager::init() {
@@ -53,7 +240,14 @@ void LE_TextureManager::init() {
 }
 
 void LE_TextureManager::clean () {
+    // Workers are stopped first, pending loads would target deleted windows
+    if ( loader != nullptr ) {
+        delete loader;
+        loader = nullptr;
+    }
+
     for ( auto it = windows.begin(); it != windows.end(); it++ ) {
+        invalidateTileHandles ( it->second, nullptr, nullptr );
         delete it->second;
     }
     windows.clear();
@@ -69,6 +263,8 @@ Uint32 LE_TextureManager::createWindow (
         bool borderless,
         bool resizable
         ) {
+    if ( headless ) return createOffscreenWindow ( h, w );
+
     SDL_Window* newWindow;
     SDL_Renderer* newRenderer;
 
@@ -95,7 +291,7 @@ Uint32 LE_TextureManager::createWindow (
 
     Uint32 winId = SDL_GetWindowID ( newWindow );
 
-    windows[winId] = new LE_Window ( newWindow, newRenderer );
+    windows[winId] = new LE_Window ( newWindow, newRenderer, &imageCache );
     return winId;
 }
 
@@ -111,12 +307,117 @@ Uint32 LE_TextureManager::addWindow ( SDL_Window* newWindow ) {
 
     Uint32 winId = SDL_GetWindowID ( newWindow );
 
-    windows[winId] = new LE_Window ( newWindow, newRenderer );
+    windows[winId] = new LE_Window ( newWindow, newRenderer, &imageCache );
     return winId;
 }
 
+Uint32 LE_TextureManager::createOffscreenWindow ( int h, int w ) {
+    SDL_Surface* target = SDL_CreateRGBSurfaceWithFormat ( 0, w, h, 32,
+            SDL_PIXELFORMAT_ARGB8888 );
+    if ( target == NULL ) {
+        cerr << "Error creating offscreen surface: " << SDL_GetError() << endl;
+        return 0;
+    }
+
+    SDL_Renderer* newRenderer = SDL_CreateSoftwareRenderer ( target );
+    if ( newRenderer == NULL ) {
+        cerr << "Error initializing software renderer: " << SDL_GetError() << endl;
+        SDL_FreeSurface ( target );
+        return 0;
+    }
+
+    Uint32 winId = nextOffscreenId++;
+
+    windows[winId] = new LE_Window ( target, newRenderer, &imageCache );
+    return winId;
+}
+
+SDL_Surface* LE_TextureManager::readFrame ( LE_Window* window ) {
+    flushWindow ( window );
+    SDL_Renderer* renderer = window->getRenderer();
+
+    // Read the whole target, not only the viewport
+    SDL_Rect viewport, full;
+    SDL_RenderGetViewport ( renderer, &viewport );
+    SDL_RenderSetViewport ( renderer, NULL );
+    SDL_RenderGetViewport ( renderer, &full );
+
+    SDL_Surface* frame = SDL_CreateRGBSurfaceWithFormat ( 0, full.w, full.h, 32,
+            SDL_PIXELFORMAT_ARGB8888 );
+    int result = -1;
+    if ( frame != NULL ) {
+        result = SDL_RenderReadPixels ( renderer, NULL,
+                SDL_PIXELFORMAT_ARGB8888, frame->pixels, frame->pitch );
+    }
+
+    SDL_RenderSetViewport ( renderer, &viewport );
+
+    if ( result != 0 ) {
+        cerr << "Error reading frame: " << SDL_GetError() << endl;
+        if ( frame != NULL ) SDL_FreeSurface ( frame );
+        return nullptr;
+    }
+    return frame;
+}
+
+bool LE_TextureManager::dumpFrame ( Uint32 windowId, std::string filePath ) {
+    auto it = windows.find( windowId );
+    if ( it == windows.end() ) {
+        cerr << "Could not dump frame to " << filePath << " "
+            << "Invalid window ID: " << windowId << " Doesn't exist" << endl;
+        return false;
+    }
+
+    SDL_Surface* frame = readFrame ( it->second );
+    if ( frame == nullptr ) return false;
+
+    bool png = filePath.size() >= 4 &&
+        filePath.compare ( filePath.size() - 4, 4, ".png" ) == 0;
+    int result = png ? IMG_SavePNG ( frame, filePath.c_str() )
+                     : SDL_SaveBMP ( frame, filePath.c_str() );
+    SDL_FreeSurface ( frame );
+
+    if ( result != 0 ) {
+        cerr << "Could not dump frame to " << filePath << ": " << SDL_GetError() << endl;
+        return false;
+    }
+    return true;
+}
+
+Uint64 LE_TextureManager::frameChecksum ( Uint32 windowId ) {
+    auto it = windows.find( windowId );
+    if ( it == windows.end() ) {
+        cerr << "Could not checksum frame. "
+            << "Invalid window ID: " << windowId << " Doesn't exist" << endl;
+        return 0;
+    }
+
+    SDL_Surface* frame = readFrame ( it->second );
+    if ( frame == nullptr ) return 0;
+
+    Uint64 hash = 14695981039346656037ULL;
+    auto mix = [&hash]( const Uint8* bytes, size_t count ) {
+        for ( size_t i = 0; i < count; i++ ) {
+            hash ^= bytes[i];
+            hash *= 1099511628211ULL;
+        }
+    };
+
+    Uint32 size[2] = { (Uint32)frame->w, (Uint32)frame->h };
+    mix ( (const Uint8*)size, sizeof(size) );
+
+    // Rows may be padded, only hash the pixels
+    for ( int y = 0; y < frame->h; y++ ) {
+        mix ( (const Uint8*)frame->pixels + y * frame->pitch, frame->w * 4 );
+    }
+
+    SDL_FreeSurface ( frame );
+    return hash;
+}
+
 void LE_TextureManager::loadTexture ( Uint32 windowId,
         std::string filePath, std::string textureId ) {
+    LE_PROFILE_SCOPE ( "load texture" );
 
     auto it = windows.find( windowId );
     if ( it == windows.end() ) {
@@ -127,7 +428,7 @@ void LE_TextureManager::loadTexture ( Uint32 windowId,
 
     LE_Window* leWin = it->second;
 
-    if ( leWin->getTexture ( textureId ) != nullptr ) {
+    if ( leWin->hasTexture ( textureId ) ) {
         cerr << "Could not load texture from path " << filePath << " "
             << "Invalid texture Id: " << textureId << " already exists "
             << "For " << windowId << " window, please deallocate it before "
@@ -135,23 +436,115 @@ void LE_TextureManager::loadTexture ( Uint32 windowId,
         return;
     }
 
-    SDL_Surface* tempSurface = IMG_Load ( filePath.c_str() );
-    if ( tempSurface == nullptr ) {
-        cerr << "Error loading image " << filePath << ": " << IMG_GetError() << endl;
+    addImageTexture ( windowId, filePath, textureId, nullptr );
+}
+
+bool LE_TextureManager::addImageTexture ( Uint32 windowId, const std::string& filePath,
+        const std::string& textureId, SDL_Surface* decoded ) {
+
+    auto it = windows.find( windowId );
+    if ( it == windows.end() ) {
+        cerr << "Could not load texture from path " << filePath << " "
+            << "Invalid window ID: " << windowId << " Doesn't exist" << endl;
+        if ( decoded != nullptr ) SDL_FreeSurface ( decoded );
+        return false;
+    }
+
+    LE_Window* leWin = it->second;
+
+    if ( leWin->hasTexture ( textureId ) ) {
+        cerr << "Could not load texture from path " << filePath << " "
+            << "Invalid texture Id: " << textureId << " already exists "
+            << "For " << windowId << " window, please deallocate it before "
+            << "Overwriting" << endl;
+        if ( decoded != nullptr ) SDL_FreeSurface ( decoded );
+        return false;
+    }
+
+    // Decodes the image only if no other window loaded it yet
+    if ( imageCache.acquire ( filePath, decoded ) == nullptr ) return false;
+
+    leWin->addImage ( textureId, filePath );
+    leWin->dirty = true;
+    retryTileHandles ( windowId );
+    return true;
+}
+
+void LE_TextureManager::loadTextureAsync ( Uint32 windowId, std::string filePath,
+        std::string textureId, LE_LoadCallback onDone ) {
+
+    if ( windows.find( windowId ) == windows.end() ) {
+        cerr << "Could not load texture from path " << filePath << " "
+            << "Invalid window ID: " << windowId << " Doesn't exist" << endl;
+        if ( onDone ) onDone ( false );
         return;
     }
 
-    SDL_Texture* newTexture = SDL_CreateTextureFromSurface (
-            leWin->sdl_renderer,
-            tempSurface
-            );
+    if ( loader == nullptr ) {
+        loader = new LE_TextureLoader ( loaderThreads );
+    }
 
-    if ( newTexture == nullptr ) {
-        cerr << "Error loading image " << filePath << ": " << IMG_GetError() << endl;
+    LE_LoadRequest* req = new LE_LoadRequest;
+    req->windowId = windowId;
+    req->filePath = filePath;
+    req->textureId = textureId;
+    req->onDone = onDone;
+
+    // Images already decoded for another window skip the workers
+    if ( imageCache.contains ( filePath ) ) {
+        loader->complete ( req );
+    } else {
+        loader->push ( req );
+    }
+}
+
+void LE_TextureManager::setLoaderThreads ( int threads ) {
+    if ( threads < 1 ) {
+        cerr << "Invalid number of loader threads: " << threads << endl;
         return;
     }
+    loaderThreads = threads;
+
+    // Restart the workers if nothing is being loaded
+    if ( loader != nullptr && loader->count() == 0 ) {
+        delete loader;
+        loader = nullptr;
+    }
+}
 
-    leWin->addTexture ( textureId, newTexture );
+void LE_TextureManager::processAsyncLoads () {
+    if ( loader == nullptr ) return;
+    LE_PROFILE_SCOPE ( "upload textures" );
+
+    Uint64 start = SDL_GetPerformanceCounter();
+    Uint64 budget = uploadBudget * SDL_GetPerformanceFrequency() / 1000.0;
+
+    // At least one texture is uploaded per call so loading never stalls
+    LE_LoadRequest* req;
+    while ( loader != nullptr && ( req = loader->pop() ) != nullptr ) {
+        bool loaded = false;
+        if ( !req->error.empty() ) {
+            cerr << "Error loading image " << req->filePath << ": "
+                << req->error << endl;
+        } else {
+            loaded = addImageTexture ( req->windowId, req->filePath,
+                    req->textureId, req->surface );
+            // Create the texture now, within the budget, instead of on its first draw
+            if ( loaded ) {
+                LE_Window* window = windows[req->windowId];
+                loaded = window->getTexture ( req->textureId ) != nullptr;
+                checkBudget ( window );
+            }
+        }
+
+        LE_LoadCallback onDone = req->onDone;
+        delete req;
+
+        // May load more textures or even clean the texture manager
+        if ( onDone ) onDone ( loaded );
+
+        if ( SDL_GetPerformanceCounter() - start >= budget ) break;
+    }
 }
 
 void LE_TextureManager::createTile ( Uint32 windowId, std::string textureId,
@@ -164,14 +557,122 @@ void LE_TextureManager::createTile ( Uint32 windowId, std::string textureId,
     }
 
     if ( h == 0 || w == 0 ) {
-        SDL_QueryTexture ( it->second->getTexture ( textureId ),
-                NULL, NULL, &w, &h );
+        it->second->getTextureSize ( textureId, &h, &w );
+    }
+    addTile ( windowId, tileId, new LE_Tile( textureId, x, y, h, w ) );
+}
+
+LE_TileHandle LE_TextureManager::resolveTile ( Uint32 windowId, const std::string& tileId ) {
+    auto key = std::make_pair( windowId, tileId );
+    std::lock_guard<std::mutex> lock ( handleMutex );
+    auto it = tileHandleIndex.find( key );
+    if ( it != tileHandleIndex.end() ) {
+        return it->second;
+    }
+
+    LE_TileHandle handle = tileHandles.size();
+    LE_ResolvedTile entry;
+    entry.windowId = windowId;
+    entry.tileId = tileId;
+    entry.version = 0;
+    entry.failed = false;
+    entry.window = nullptr;
+    entry.entry = nullptr;
+    entry.tile = nullptr;
+    entry.texture = nullptr;
+
+    tileHandles.push_back( entry );
+    tileHandleIndex[key] = handle;
+    return handle;
+}
+
+bool LE_TextureManager::resolveHandle ( LE_ResolvedTile& entry ) {
+    entry.failed = true;
+    auto it = windows.find( entry.windowId );
+    if ( it == windows.end() ) {
+        cerr << "Error drawing tile: window id " << entry.windowId <<
+            " doesn't exist" << endl;
+        return false;
+    }
+
+    LE_Tile* tile = it->second->getTile ( entry.tileId );
+    if ( tile == nullptr ) {
+        cerr << "Error drawing tile: tile Id: " << entry.tileId
+            << " doesn't exist" << endl;
+        return false;
+    }
+
+    LE_TextureEntry* texEntry = it->second->getEntry ( tile->textureId );
+    if ( texEntry == nullptr ) {
+        cerr << "Error drawing tile: texture Id: " << tile->textureId
+            << " doesn't exist" << endl;
+        return false;
     }
-    it->second->addTile( tileId, new LE_Tile( textureId, x, y, h, w ) );
+    // Stamped before checking the budget so it isn't evicted
+    texEntry->lastUsed = frameCount;
+    checkBudget ( it->second );
+
+    LE_DrawCommand cmd;
+    if ( !setCommandTexture ( cmd, texEntry->texture ) ) {
+        return false;
+    }
+
+    entry.window = it->second;
+    entry.entry = texEntry;
+    entry.tile = tile;
+    entry.texture = texEntry->texture;
+    entry.src.x = tile->x;
+    entry.src.y = tile->y;
+    entry.src.h = tile->h;
+    entry.src.w = tile->w;
+    entry.frame.x = tile->trim_x;
+    entry.frame.y = tile->trim_y;
+    entry.frame.h = tile->full_h;
+    entry.frame.w = tile->full_w;
+    entry.texW = cmd.texW;
+    entry.texH = cmd.texH;
+    entry.blendMode = cmd.blendMode;
+    entry.color = cmd.color;
+    entry.failed = false;
+    return true;
 }
 
-bool LE_TextureManager::draw ( Uint32 windowId, std::string tileId, int x, int y, double h, double w,
-       bool scale, bool flipv, bool fliph, const double angle) {
+void LE_TextureManager::invalidateTileHandles ( LE_Window* window, LE_TextureEntry* entry,
+        LE_Tile* tile ) {
+    std::lock_guard<std::mutex> lock ( handleMutex );
+    for ( LE_ResolvedTile& handle : tileHandles ) {
+        if ( handle.window == nullptr ) continue;
+        if ( handle.window == window || handle.entry == entry || handle.tile == tile ) {
+            handle.window = nullptr;
+            handle.version++;
+        }
+    }
+}
+
+void LE_TextureManager::retryTileHandles ( Uint32 windowId ) {
+    // Handles that failed may draw now
+    std::lock_guard<std::mutex> lock ( handleMutex );
+    for ( LE_ResolvedTile& handle : tileHandles ) {
+        if ( handle.failed && handle.windowId == windowId ) handle.version++;
+    }
+}
+
+bool LE_TextureManager::setCommandTexture ( LE_DrawCommand& cmd, SDL_Texture* texture ) {
+    cmd.texture = texture;
+
+    if ( SDL_QueryTexture ( texture, NULL, NULL, &cmd.texW, &cmd.texH ) < 0 ) {
+        cerr << "Error rendering tile " << SDL_GetError() << endl;
+        return false;
+    }
+    SDL_GetTextureBlendMode ( texture, &cmd.blendMode );
+    SDL_GetTextureColorMod ( texture, &cmd.color.r, &cmd.color.g, &cmd.color.b );
+    SDL_GetTextureAlphaMod ( texture, &cmd.color.a );
+    return true;
+}
+
+bool LE_TextureManager::draw ( Uint32 windowId, const std::string& tileId, int x, int y, double h, double w,
+       bool scale, bool flipv, bool fliph, const double angle, int layer, int z,
+       bool screenSpace ) {
 
     auto it = windows.find( windowId );
     if ( it == windows.end() ) {
@@ -186,35 +687,424 @@ bool LE_TextureManager::draw ( Uint32 windowId, std::string tileId, int x, int y
             << " doesn't exist" << endl;
         return false;
     }
-    SDL_Texture* texture = it->second->getTexture ( tile->textureId );
+    LE_TextureEntry* texEntry = it->second->getEntry ( tile->textureId );
+    if ( texEntry == nullptr ) {
+        cerr << "Error drawing tile: texture Id: " << tile->textureId
+            << " doesn't exist" << endl;
+        return false;
+    }
+    texEntry->lastUsed = frameCount;
+    checkBudget ( it->second );
+
+    LE_DrawCommand cmd;
+    if ( !setCommandTexture ( cmd, texEntry->texture ) ) {
+        return false;
+    }
+
+    cmd.src.x = tile->x;
+    cmd.src.y = tile->y;
+    cmd.src.h = tile->h;
+    cmd.src.w = tile->w;
+
+    SDL_Rect frame = { tile->trim_x, tile->trim_y, tile->full_w, tile->full_h };
+
+    return drawTile ( it->second, cmd, frame, x, y, h, w, scale, flipv, fliph, angle,
+            layer, z, screenSpace );
+}
+
+bool LE_TextureManager::draw ( LE_TileHandle tileHandle, int x, int y, double h, double w,
+       bool scale, bool flipv, bool fliph, const double angle, int layer, int z,
+       bool screenSpace ) {
+
+    LE_ResolvedTile* found = nullptr;
+    {
+        // Other threads may be adding handles, entries themselves don't move
+        std::lock_guard<std::mutex> lock ( handleMutex );
+        if ( tileHandle < tileHandles.size() ) found = &tileHandles[tileHandle];
+    }
+    if ( found == nullptr ) {
+        cerr << "Error drawing tile: invalid tile handle " << tileHandle << endl;
+        return false;
+    }
+
+    LE_ResolvedTile& entry = *found;
+    // Evicted textures are created again by resolveHandle
+    bool resolved = entry.window != nullptr && entry.texture == entry.entry->texture;
+    if ( !resolved && !resolveHandle( entry ) ) {
+        return false;
+    }
+
+    entry.entry->lastUsed = frameCount;
+
+    LE_DrawCommand cmd;
+    cmd.texture = entry.texture;
+    cmd.blendMode = entry.blendMode;
+    cmd.color = entry.color;
+    cmd.texW = entry.texW;
+    cmd.texH = entry.texH;
+    cmd.src = entry.src;
+
+    return drawTile ( entry.window, cmd, entry.frame, x, y, h, w, scale, flipv, fliph, angle,
+            layer, z, screenSpace );
+}
 
-    SDL_RendererFlip flip = SDL_FLIP_NONE;
-    if ( flipv ) flip = SDL_FLIP_VERTICAL;
-    else if ( fliph ) flip = SDL_FLIP_HORIZONTAL;
+bool LE_TextureManager::drawTile ( LE_Window* window, LE_DrawCommand& cmd, const SDL_Rect& frame,
+        int x, int y, double h, double w,
+        bool scale, bool flipv, bool fliph, const double angle,
+        int layer, int z, bool screenSpace ) {
 
-    SDL_Rect src, dst;
+    // Windows that are not being redrawn keep their last frame
+    if ( dropsDraws ( window ) ) return true;
 
-    src.x = tile->x;
-    src.y = tile->y;
-    src.h = tile->h;
-    src.w = tile->w;
+    cmd.flip = SDL_FLIP_NONE;
+    if ( flipv ) cmd.flip = SDL_FLIP_VERTICAL;
+    else if ( fliph ) cmd.flip = SDL_FLIP_HORIZONTAL;
 
-    dst.x = x;
-    dst.y = y;
+    cmd.angle = angle;
 
+    // Size of the whole (untrimmed) tile, truncated to whole pixels
+    int dst_w, dst_h;
     if ( scale ) {
-        dst.w = src.w * w;
-        dst.h = src.h * h;
+        dst_w = (int)( frame.w * w );
+        dst_h = (int)( frame.h * h );
     } else {
-        dst.w = w;
-        dst.h = h;
+        dst_w = (int)w;
+        dst_h = (int)h;
+    }
+
+    cmd.dst.x = x;
+    cmd.dst.y = y;
+    cmd.dst.w = dst_w;
+    cmd.dst.h = dst_h;
+
+    if ( cmd.src.w != frame.w || cmd.src.h != frame.h ) {
+        // Trimmed tile: only draw the part of the frame that has pixels,
+        // mirroring the trimmed offsets when flipped
+        float sx = (float)dst_w / frame.w;
+        float sy = (float)dst_h / frame.h;
+
+        int left = frame.x;
+        int top = frame.y;
+        if ( cmd.flip & SDL_FLIP_HORIZONTAL ) left = frame.w - frame.x - cmd.src.w;
+        if ( cmd.flip & SDL_FLIP_VERTICAL ) top = frame.h - frame.y - cmd.src.h;
+
+        cmd.dst.x += left * sx;
+        cmd.dst.y += top * sy;
+        cmd.dst.w = cmd.src.w * sx;
+        cmd.dst.h = cmd.src.h * sy;
+    }
+
+    // Rotate around the center of the whole tile
+    cmd.center.x = x + dst_w / 2.0f - cmd.dst.x;
+    cmd.center.y = y + dst_h / 2.0f - cmd.dst.y;
+
+    // The view is in world coordinates, screen space draws are not culled
+    bool world = !screenSpace || window->camera == nullptr ||
+                 window->onTarget || window->building != nullptr;
+    if ( culling && world && !isVisible ( windowView ( window ), cmd ) ) {
+        stats.culled++;
+        return true;
+    }
+
+    transformCommand ( window, cmd, screenSpace );
+    return submit ( window, cmd, layer, z );
+}
+
+bool LE_TextureManager::beginCachedLayer ( Uint32 windowId, const std::string& layerId,
+        int x, int y, int h, int w ) {
+    auto it = windows.find ( windowId );
+    if ( it == windows.end() ) {
+        cerr << "Error drawing cached layer " << layerId << ": "
+            << "window id " << windowId << " doesn't exist" << endl;
+        return false;
+    }
+    LE_Window* window = it->second;
+
+    if ( window->building != nullptr ) {
+        cerr << "Error drawing cached layer " << layerId << ": "
+            << "cached layers can't be nested" << endl;
+        return false;
+    }
+
+    auto found = window->cachedLayers.find ( layerId );
+    if ( found == window->cachedLayers.end() ) {
+        found = window->cachedLayers.insert ( { layerId, { nullptr, { x, y, w, h }, false, false } } ).first;
+    }
+    LE_CachedLayer& layer = found->second;
+
+    if ( layer.area.x != x || layer.area.y != y ) {
+        layer.area.x = x;
+        layer.area.y = y;
+        layer.valid = false;
     }
+    if ( layer.area.w != w || layer.area.h != h ) {
+        if ( layer.texture != nullptr ) window->releaseTarget ( layer.texture );
+        layer.texture = nullptr;
+        layer.area.w = w;
+        layer.area.h = h;
+        layer.valid = layer.direct = false;
+    }
+
+    if ( layer.valid ) return false;
+    if ( w <= 0 || h <= 0 ) return false;
+    if ( layer.direct ) return true;
+
+    if ( layer.texture == nullptr ) {
+        layer.texture = window->acquireTarget ( h, w );
+        if ( layer.texture == nullptr ) {
+            layer.direct = true;
+            return true;
+        }
+    }
+
+    // Queued draws stay queued, only the batch belongs to the previous target
+    flushBatch ( window );
+
+    window->buildingPrevTarget = SDL_GetRenderTarget ( window->sdl_renderer );
+    SDL_SetRenderTarget ( window->sdl_renderer, layer.texture );
+    SDL_SetRenderDrawColor ( window->sdl_renderer, 0, 0, 0, 0 );
+    SDL_RenderClear ( window->sdl_renderer );
+
+    window->building = &layer;
+    window->viewValid = false;
+    return true;
+}
+
+void LE_TextureManager::endCachedLayer ( Uint32 windowId, const std::string& layerId,
+        int layer, int z ) {
+    auto it = windows.find ( windowId );
+    if ( it == windows.end() ) return;
+    LE_Window* window = it->second;
+
+    auto found = window->cachedLayers.find ( layerId );
+    if ( found == window->cachedLayers.end() ) return;
+    LE_CachedLayer& cached = found->second;
+
+    if ( window->building == &cached ) {
+        flushBatch ( window );
+        SDL_SetRenderTarget ( window->sdl_renderer, window->buildingPrevTarget );
+        window->building = nullptr;
+        window->viewValid = false;
+        cached.valid = true;
+    }
+
+    if ( !cached.valid ) return;
+
+    // Windows that are not being redrawn keep their last frame
+    if ( dropsDraws ( window ) ) return;
+
+    LE_DrawCommand cmd;
+    if ( !setCommandTexture ( cmd, cached.texture ) ) return;
+
+    cmd.src = { 0, 0, cached.area.w, cached.area.h };
+    cmd.dst = { (float)cached.area.x, (float)cached.area.y,
+                (float)cached.area.w, (float)cached.area.h };
+    cmd.angle = 0;
+    cmd.center = { 0, 0 };
+    cmd.flip = SDL_FLIP_NONE;
+
+    if ( culling && !isVisible ( windowView ( window ), cmd ) ) {
+        stats.culled++;
+        return;
+    }
+    transformCommand ( window, cmd, false );
+    submit ( window, cmd, layer, z );
+}
 
-    if ( 0 >
-      SDL_RenderCopyEx( it->second->getRenderer(), texture, &src, &dst, angle, NULL, flip) ) {
+void LE_TextureManager::popCachedLayer ( Uint32 windowId, const std::string& layerId ) {
+    auto it = windows.find ( windowId );
+    if ( it == windows.end() ) return;
+    LE_Window* window = it->second;
+
+    auto found = window->cachedLayers.find ( layerId );
+    if ( found == window->cachedLayers.end() ) return;
+
+    if ( window->building == &found->second ) {
+        cerr << "Error removing cached layer " << layerId << ": "
+            << "it is being drawn" << endl;
+        return;
+    }
+
+    // Queued draws may still use its texture
+    flushWindow ( window );
+    if ( found->second.texture != nullptr ) window->releaseTarget ( found->second.texture );
+    window->cachedLayers.erase ( found );
+}
+
+void LE_TextureManager::transformCommand ( LE_Window* window, LE_DrawCommand& cmd, bool screenSpace ) {
+    // Cached layer textures start at the layer area origin
+    if ( window->building != nullptr ) {
+        cmd.dst.x -= window->building->area.x;
+        cmd.dst.y -= window->building->area.y;
+        return;
+    }
+    if ( window->onTarget ) {
+        cmd.dst.x -= window->targetOrigin.x;
+        cmd.dst.y -= window->targetOrigin.y;
+        return;
+    }
+
+    LE_Camera* cam = window->camera;
+    if ( cam == nullptr || screenSpace ) return;
+
+    // Move the rotation center, then scale the tile around it
+    double cx, cy;
+    cam->toViewport ( cmd.dst.x + cmd.center.x, cmd.dst.y + cmd.center.y, &cx, &cy );
+
+    cmd.center.x *= cam->zoom;
+    cmd.center.y *= cam->zoom;
+    cmd.dst.w *= cam->zoom;
+    cmd.dst.h *= cam->zoom;
+    cmd.dst.x = cx - cmd.center.x;
+    cmd.dst.y = cy - cmd.center.y;
+    cmd.angle -= cam->angle;
+
+    if ( cam->pixelSnap ) {
+        // Snap edges, so neighbour tiles keep touching
+        float x0 = std::round ( cmd.dst.x ), y0 = std::round ( cmd.dst.y );
+        if ( cmd.angle == 0 ) {
+            cmd.dst.w = std::round ( cmd.dst.x + cmd.dst.w ) - x0;
+            cmd.dst.h = std::round ( cmd.dst.y + cmd.dst.h ) - y0;
+        }
+        cmd.dst.x = x0;
+        cmd.dst.y = y0;
+    }
+}
+
+LE_Camera* LE_TextureManager::addCamera ( Uint32 windowId, std::string cameraId ) {
+    auto it = windows.find ( windowId );
+    if ( it == windows.end() ) {
+        cerr << "Error adding camera " << cameraId << ": "
+            << "window id " << windowId << " doesn't exist" << endl;
+        return nullptr;
+    }
+
+    LE_Camera* cam = getCamera ( windowId, cameraId );
+    if ( cam != nullptr ) return cam;
+
+    cam = new LE_Camera ( cameraId );
+    it->second->cameras.push_back ( cam );
+    it->second->dirty = true;
+    return cam;
+}
+
+LE_Camera* LE_TextureManager::getCamera ( Uint32 windowId, const std::string& cameraId ) {
+    auto it = windows.find ( windowId );
+    if ( it == windows.end() ) return nullptr;
+
+    for ( LE_Camera* cam : it->second->cameras ) {
+        if ( cam->id == cameraId ) return cam;
+    }
+    return nullptr;
+}
+
+void LE_TextureManager::popCamera ( Uint32 windowId, const std::string& cameraId ) {
+    auto it = windows.find ( windowId );
+    if ( it == windows.end() ) return;
+    LE_Window* window = it->second;
+
+    for ( size_t i = 0; i < window->cameras.size(); i++ ) {
+        LE_Camera* cam = window->cameras[i];
+        if ( cam->id != cameraId ) continue;
+
+        if ( window->camera == cam ) endCameraPass ( windowId );
+        window->cameras.erase ( window->cameras.begin() + i );
+        delete cam;
+        window->dirty = true;
+        return;
+    }
+}
+
+bool LE_TextureManager::beginCameraPass ( Uint32 windowId, int index ) {
+    auto it = windows.find ( windowId );
+    if ( it == windows.end() ) return false;
+    LE_Window* window = it->second;
+
+    flushWindow ( window );
+    window->viewValid = false;
+
+    // Without cameras the window is drawn once, as is
+    if ( index < 0 || index >= (int)window->cameras.size() ) {
+        window->camera = nullptr;
+        window->skipPass = !( window->cameras.empty() && index == 0 );
+        return !window->skipPass;
+    }
+
+    LE_Camera* cam = window->cameras[index];
+    SDL_Rect viewport = cam->viewport;
+    if ( viewport.w <= 0 || viewport.h <= 0 ) {
+        viewport.x = viewport.y = 0;
+        SDL_GetRendererOutputSize ( window->sdl_renderer, &viewport.w, &viewport.h );
+    }
+
+    SDL_RenderSetViewport ( window->sdl_renderer, &viewport );
+    SDL_Rect clip = { 0, 0, viewport.w, viewport.h };
+    SDL_RenderSetClipRect ( window->sdl_renderer, &clip );
+
+    cam->update ( viewport.w, viewport.h );
+    window->camera = cam;
+    window->skipPass = false;
+    return true;
+}
+
+void LE_TextureManager::endCameraPass ( Uint32 windowId ) {
+    auto it = windows.find ( windowId );
+    if ( it == windows.end() ) return;
+    LE_Window* window = it->second;
+
+    flushWindow ( window );
+    if ( window->camera != nullptr ) {
+        SDL_RenderSetClipRect ( window->sdl_renderer, NULL );
+        SDL_RenderSetViewport ( window->sdl_renderer, NULL );
+    }
+    window->camera = nullptr;
+    window->skipPass = false;
+    window->viewValid = false;
+}
+
+bool LE_TextureManager::isVisible ( const SDL_Rect& view, const LE_DrawCommand& cmd ) {
+    float left = cmd.dst.x, top = cmd.dst.y;
+    float right = left + cmd.dst.w, bottom = top + cmd.dst.h;
+
+    if ( cmd.angle != 0 ) {
+        // Any rotation stays inside the circle around the rotation center
+        float cx = cmd.dst.x + cmd.center.x;
+        float cy = cmd.dst.y + cmd.center.y;
+        float dx = std::max ( std::fabs ( left - cx ), std::fabs ( right - cx ) );
+        float dy = std::max ( std::fabs ( top - cy ), std::fabs ( bottom - cy ) );
+        float r = std::sqrt ( dx * dx + dy * dy );
+        left = cx - r;
+        right = cx + r;
+        top = cy - r;
+        bottom = cy + r;
+    }
+
+    return right > view.x && left < view.x + view.w &&
+           bottom > view.y && top < view.y + view.h;
+}
+
+bool LE_TextureManager::submit ( LE_Window* window, const LE_DrawCommand& cmd, int layer, int z ) {
+    stats.sprites++;
+
+    if ( renderQueue && window->building == nullptr && !window->onTarget ) {
+        window->queue.push ( cmd, layer, z );
+        return true;
+    }
+    return dispatch ( window, cmd );
+}
+
+bool LE_TextureManager::dispatch ( LE_Window* window, const LE_DrawCommand& cmd ) {
+    if ( batching ) {
+        stats.drawCalls += window->batch.push ( cmd );
+        return true;
+    }
+
+    if ( 0 > SDL_RenderCopyExF( window->getRenderer(), cmd.texture, &cmd.src, &cmd.dst,
+                cmd.angle, &cmd.center, cmd.flip ) ) {
         cerr << "Error rendering tile " << SDL_GetError() << endl;
         return false;
     }
+    stats.drawCalls++;
 
     return true;
 }
@@ -228,6 +1118,8 @@ void LE_TextureManager::setBlendMode ( LE_BlendMode blendMode,
             << "windowId: " << windowId << " doesn't exist" << std::endl;
         return;
     }
+    // Batched sprites must be drawn with the previous blend mode
+    flushBatch ( it->second );
 
     if ( textureId == "" ) {
         if ( SDL_SetRenderDrawBlendMode ( it->second->getRenderer(),
@@ -248,10 +1140,40 @@ void LE_TextureManager::setBlendMode ( LE_BlendMode blendMode,
                     << SDL_GetError() << std::endl;
                 return;
             }
+            // Tile handles cache the texture blend mode
+            auto found = it->second->sdl_textures.find ( textureId );
+            invalidateTileHandles ( nullptr, &found->second, nullptr );
+            it->second->dirty = true;
         }
     }
 }
 
+/**
+ * @brief atlas builder of the file being read by loadFromXmlFile
+ * */
+static LE_AtlasBuilder* xmlAtlas = nullptr;
+
+/**
+ * @brief tile read by loadFromXmlFileAsync, h and w are 0 for whole textures
+ * */
+typedef struct XmlAsyncTile {
+    std::string tileId;
+    int x, y, h, w;
+} XmlAsyncTile;
+
+/**
+ * @brief texture read by loadFromXmlFileAsync, with the tiles to create once loaded
+ * */
+typedef struct XmlAsyncTexture {
+    std::string textureId;
+    std::string filePath;
+    std::vector<XmlAsyncTile> tiles;
+} XmlAsyncTexture;
+
+/**
+ * @brief textures of the file being read by loadFromXmlFileAsync
+ * */
+static std::vector<XmlAsyncTexture>* xmlAsync = nullptr;
 
 void texture_onRead ( const Attr& attr, const std::string value ) {
     std::string filepath = attr.at("filepath");
@@ -264,6 +1186,17 @@ void texture_onRead ( const Attr& attr, const std::string value ) {
                 );
     }
 
+    if ( xmlAsync != nullptr ) {
+        xmlAsync->push_back ( { attr.at("id"), filepath, {} } );
+        return;
+    }
+
+    auto atlas = attr.find("atlas");
+    if ( xmlAtlas != nullptr && atlas != attr.end() ) {
+        xmlAtlas->addImage ( attr.at("id"), filepath, atlas->second );
+        return;
+    }
+
     LE_TEXTURE->loadTexture (
             stoi(attr.at("windowId")),
             filepath,
@@ -273,6 +1206,40 @@ void texture_onRead ( const Attr& attr, const std::string value ) {
 
 void set_onRead ( const Attr& attr, const std::string value ) {
     auto it = attr.find("x");
+
+    if ( xmlAsync != nullptr ) {
+        XmlAsyncTile tile = { attr.at("tile"), 0, 0, 0, 0 };
+        if ( it != attr.end() ) {
+            tile.x = stoi(attr.at("x"));
+            tile.y = stoi(attr.at("y"));
+            tile.h = stoi(attr.at("h"));
+            tile.w = stoi(attr.at("w"));
+        }
+        // The parent texture is usually the last one read
+        for ( auto tex = xmlAsync->rbegin(); tex != xmlAsync->rend(); tex++ ) {
+            if ( tex->textureId == attr.at("id") ) {
+                tex->tiles.push_back ( tile );
+                break;
+            }
+        }
+        return;
+    }
+
+    if ( xmlAtlas != nullptr && xmlAtlas->hasImage ( attr.at("id") ) ) {
+        if ( it != attr.end() ) {
+            xmlAtlas->addTile (
+                    attr.at("id"),
+                    attr.at("tile"),
+                    stoi(attr.at("x")),
+                    stoi(attr.at("y")),
+                    stoi(attr.at("h")),
+                    stoi(attr.at("w"))
+                    );
+        } else {
+            xmlAtlas->addTile ( attr.at("id"), attr.at("tile") );
+        }
+        return;
+    }
     if ( it != attr.end() ) {
         LE_TEXTURE->createTile (
                 stoi(attr.at("windowId")),
@@ -292,7 +1259,8 @@ void set_onRead ( const Attr& attr, const std::string value ) {
     }
 }
 
-void LE_TextureManager::loadFromXmlFile ( std::string filePath, Uint32 windowId ) {
+void LE_TextureManager::loadFromXmlFile ( std::string filePath, Uint32 windowId, bool atlas ) {
+    LE_PROFILE_SCOPE ( "load xml" );
 
     LE_XMLNode mainNode ( "TILESETS" ),
                textureN ( "texture" ),
@@ -303,9 +1271,67 @@ void LE_TextureManager::loadFromXmlFile ( std::string filePath, Uint32 windowId
 
     Attr attr;
     attr["windowId"] = std::to_string(windowId);
+    if ( atlas ) attr["atlas"] = filePath;
 
     textureN.setOnRead ( texture_onRead );
     setN.setOnRead ( set_onRead );
 
+    LE_AtlasBuilder builder;
+    xmlAtlas = &builder;
+
     mainNode.readDoc ( filePath, &attr );
+
+    xmlAtlas = nullptr;
+    builder.build ( windowId );
+}
+
+void LE_TextureManager::loadFromXmlFileAsync ( std::string filePath, Uint32 windowId,
+        LE_LoadCallback onDone ) {
+
+    LE_XMLNode mainNode ( "TILESETS" ),
+               textureN ( "texture" ),
+               setN ( "set" );
+
+    mainNode.addChild( &textureN );
+    textureN.addChild( &setN );
+
+    Attr attr;
+    attr["windowId"] = std::to_string(windowId);
+
+    textureN.setOnRead ( texture_onRead );
+    setN.setOnRead ( set_onRead );
+
+    std::vector<XmlAsyncTexture> textures;
+    xmlAsync = &textures;
+
+    mainNode.readDoc ( filePath, &attr );
+
+    xmlAsync = nullptr;
+
+    if ( textures.empty() ) {
+        if ( onDone ) onDone ( true );
+        return;
+    }
+
+    // Shared by the callbacks of every texture, the last one calls onDone
+    std::shared_ptr<int> remaining = std::make_shared<int>( textures.size() );
+    std::shared_ptr<bool> allLoaded = std::make_shared<bool>( true );
+
+    for ( const XmlAsyncTexture& tex : textures ) {
+        std::string textureId = tex.textureId;
+        std::vector<XmlAsyncTile> tiles = tex.tiles;
+
+        loadTextureAsync ( windowId, tex.filePath, tex.textureId,
+                [this, windowId, textureId, tiles, remaining, allLoaded, onDone] ( bool loaded ) {
+                    if ( loaded ) {
+                        for ( const XmlAsyncTile& tile : tiles ) {
+                            createTile ( windowId, textureId, tile.tileId,
+                                    tile.x, tile.y, tile.h, tile.w );
+                        }
+                    } else {
+                        *allLoaded = false;
+                    }
+                    if ( --(*remaining) == 0 && onDone ) onDone ( *allLoaded );
+                } );
+    }
 }
@@ -5,6 +5,8 @@
     #include <map>
     #include <string>
     #include <cstdint>
+    #include <unordered_map>
+    #include "lambda_TextureManager.h"
 
     /**
      * @brief Shortcut for calling LE_TileMapManager instance
@@ -16,8 +18,6 @@
      * */
     #define QUIT_LE_TILEMAP LE_TileMapManager::destroyInstance()
 
-    typedef uint32_t Uint32;
-
     /**
      * @brief stores tile draw data
      *
@@ -70,11 +70,114 @@
              * */
             Uint32 windowId;
 
+            /**
+             * @brief draw order of every tile when the render queue is enabled
+             * */
+            int layer;
+            int z;
+
             /**
              * @brief vector of LE_TileDraeInfo
              * */
             typedef std::vector<LE_TileDrawInfo*> DrawInfo_V;
-            std::map<std::string, DrawInfo_V> draws;
+
+            /**
+             * @brief every instance of a tile in the map, along with the
+             * tile handle used to draw them
+             * */
+            typedef struct TileDraws {
+                LE_TileHandle handle;
+                DrawInfo_V infos;
+                /**
+                 * @brief tile version the grid was built with
+                 *
+                 * @see LE_TextureManager::getTileVersion
+                 * */
+                Uint32 version;
+            } TileDraws;
+            std::map<std::string, TileDraws> draws;
+
+            /**
+             * @brief size in pixels of the bulk culling grid cells
+             * */
+            static const int cellSize = 256;
+
+            /**
+             * @brief a tile instance with its bounds, in draw order
+             * */
+            typedef struct GridItem {
+                LE_TileHandle handle;
+                LE_TileDrawInfo* info;
+                SDL_Rect bounds;
+            } GridItem;
+
+            /**
+             * @brief every tile instance, in the order drawMap draws them
+             * */
+            std::vector<GridItem> gridItems;
+
+            /**
+             * @brief indices in gridItems of the tiles overlapping each cell
+             *
+             * The key packs the cell x and y coords in 32 bits each
+             * */
+            std::unordered_map<Uint64, std::vector<Uint32>> grid;
+
+            /**
+             * @brief last query each item was found in, so tiles spanning
+             * several cells are drawn once
+             * */
+            std::vector<Uint32> itemQuery;
+            Uint32 queryCount;
+
+            /** @brief indices of the tiles to draw, reused every frame */
+            std::vector<Uint32> visibleItems;
+
+            /**
+             * @brief when true the grid must be built again
+             * */
+            bool gridDirty;
+
+            /**
+             * @brief when true drawMap only visits the tiles near the view
+             * */
+            bool bulkCulling;
+
+            /**
+             * @brief area covered by every tile, computed by buildGrid
+             * */
+            SDL_Rect mapBounds;
+
+            /**
+             * @brief displacement of the map since the grid was built
+             *
+             * Moving the map doesn't build the grid again, queries and
+             * mapBounds are moved by it instead.
+             * */
+            SDL_Point gridOffset;
+
+            /**
+             * @brief id of the cached layer the map is drawn into, empty
+             * to draw every tile each frame
+             * */
+            std::string cacheId;
+
+            /**
+             * @brief Compute tile bounds and sort them into grid cells
+             * */
+            void buildGrid ();
+
+            /**
+             * @brief returns true if a tile or texture of the map changed
+             * since the grid was built
+             * */
+            bool tilesChanged ();
+
+            /**
+             * @brief Draw every tile of the map, or the ones near the view
+             * when bulk culling
+             * */
+            void drawTiles ();
 
         public:
              /**
@@ -82,18 +185,19 @@
               *
               * @param window window ID
               * */
-             LE_TileMap ( Uint32 window ): windowId(window) {}
+             LE_TileMap ( Uint32 window ): windowId(window), layer(0), z(0),
+                queryCount(0), gridDirty(true), bulkCulling(true),
+                mapBounds({ 0, 0, 0, 0 }), gridOffset({ 0, 0 }) {}
 
              /**
               * @brief class destructor
               * */
              ~LE_TileMap () {
+                 setCached ( "" );
                  for (auto it = draws.begin(); it != draws.end(); it++) {
-                    DrawInfo_V infoVect = it->second;
-                    for ( LE_TileDrawInfo* item : infoVect  ) {
+                    for ( LE_TileDrawInfo* item : it->second.infos ) {
                         delete item;
                     }
-                    infoVect.clear();
                  }
                  draws.clear();
              }
@@ -110,11 +214,14 @@
               * */
              void moveMap ( int x, int y ) {
                  for ( auto it = draws.begin(); it != draws.end(); it++ ) {
-                     for ( LE_TileDrawInfo* drawInfo : it->second ) {
+                     for ( LE_TileDrawInfo* drawInfo : it->second.infos ) {
                          drawInfo->x += x;
                          drawInfo->y += y;
                      }
                  }
+                 gridOffset.x += x;
+                 gridOffset.y += y;
+                 LE_TEXTURE->markDirty ( windowId );
              }
 
              /**
@@ -130,10 +237,65 @@
              void addDrawInfo ( std::string tileId, LE_TileDrawInfo* drawInfo ) {
                  auto it = draws.find( tileId );
                  if ( it == draws.end() ) {
-                     draws[tileId]; // Initialize empty vector
+                     // Initialize empty vector
+                     TileDraws newDraws;
+                     newDraws.handle = LE_TEXTURE->resolveTile ( windowId, tileId );
+                     newDraws.version = 0;
+                     it = draws.insert ( { tileId, newDraws } ).first;
                  }
 
-                 draws[tileId].push_back ( drawInfo );
+                 it->second.infos.push_back ( drawInfo );
+                 gridDirty = true;
+                 LE_TEXTURE->markDirty ( windowId );
+             }
+
+             /**
+              * @brief Enable or disable bulk culling
+              *
+              * While enabled (and LE_TextureManager culling is enabled),
+              * tiles are sorted into a grid of cellSize pixels, and drawMap
+              * only visits the cells overlapping the window view, so tiles
+              * far outside of it cost nothing. Tiles are still drawn in the
+              * same order. Tiles skipped are counted in LE_RenderStats::culled.
+              *
+              * Enabled by default
+              *
+              * @param enabled
+              * */
+             void setBulkCulling ( bool enabled ) { bulkCulling = enabled; }
+
+             /**
+              * @brief Draw the map into a cached layer
+              *
+              * The map is drawn once into a texture covering every tile,
+              * which is then drawn each frame, until the map is edited, or
+              * its textures and tiles change; moving it only moves the layer. Meant for maps that
+              * rarely change and fit in a texture, like backgrounds; if the
+              * texture can't be created the map is drawn as usual.
+              *
+              * @see LE_TextureManager::beginCachedLayer
+              *
+              * @param layerId cached layer id, empty to stop caching
+              * */
+             void setCached ( std::string layerId ) {
+                 if ( !cacheId.empty() && cacheId != layerId )
+                     LE_TEXTURE->popCachedLayer ( windowId, cacheId );
+                 cacheId = layerId;
+             }
+
+             /**
+              * @brief Set the layer and z the map is drawn with
+              *
+              * Only used when the render queue is enabled
+              *
+              * @see LE_TextureManager::enableRenderQueue
+              *
+              * @param m_layer
+              * @param m_z
+              * */
+             void setLayer ( int m_layer, int m_z = 0 ) {
+                 layer = m_layer;
+                 z = m_z;
              }
 
              /**
@@ -226,6 +388,37 @@
                 }
             }
 
+            /**
+             * @brief Set the layer and z a map is drawn with
+             *
+             * @param mapId
+             * @param layer
+             * @param z
+             * */
+            void setLayer ( std::string mapId, int layer, int z = 0 ) {
+                auto it = projectMaps.find(mapId);
+                if (it != projectMaps.end()) {
+                    it->second->setLayer ( layer, z );
+                }
+            }
+
+            /**
+             * @brief Enable or disable drawing a map into a cached layer
+             *
+             * The cached layer id is "tilemap:" followed by the map id
+             *
+             * @see LE_TileMap::setCached
+             *
+             * @param mapId
+             * @param enabled
+             * */
+            void setCached ( std::string mapId, bool enabled ) {
+                auto it = projectMaps.find(mapId);
+                if (it != projectMaps.end()) {
+                    it->second->setCached ( enabled ? "tilemap:" + mapId : "" );
+                }
+            }
+
             /**
              * @brief draw map into it's window
              *
@@ -256,6 +449,10 @@
              * each tile id has a list of pos tags which attributes are 
              * the same used to create LE_TileDrawInfo objects
              *
+             * tilemap tags accept optional layer and z attributes,
+             * see LE_TileMap::setLayer, and an optional cached attribute,
+             * see LE_TileMapManager::setCached
+             *
              * Example: Loading "forest-background" and "sunset-background"
              * @code
              * <TILEMAPS>
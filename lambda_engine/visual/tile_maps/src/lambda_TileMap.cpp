@@ -1,6 +1,8 @@
 #include "lambda_TileMap.h"
 #include "lambda_TextureManager.h"
 #include "lambda_XMLFabric.h"
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 
 using namespace rapidxml;
@@ -15,16 +17,171 @@ void LE_TileMap::drawMap () {
             << std::endl;
         return;
     }
+    LE_TextureManager* tm = LE_TEXTURE;
+
+    if ( cacheId.empty() ) {
+        drawTiles ();
+        return;
+    }
+
+    // Edits and changes of its tiles draw the cached layer again
+    if ( gridDirty || tilesChanged() ) {
+        buildGrid ();
+        tm->invalidateCachedLayer ( windowId, cacheId );
+    }
+
+    // The tiles moved along with the layer, it doesn't need to be drawn again
+    int x = mapBounds.x + gridOffset.x;
+    int y = mapBounds.y + gridOffset.y;
+    tm->moveCachedLayer ( windowId, cacheId, x, y );
+
+    if ( tm->beginCachedLayer ( windowId, cacheId, x, y, mapBounds.h, mapBounds.w ) ) {
+        drawTiles ();
+    }
+    tm->endCachedLayer ( windowId, cacheId, layer, z );
+}
+
+void LE_TileMap::drawTiles () {
+    LE_TextureManager* tm = LE_TEXTURE;
+
+    SDL_Rect view;
+    if ( !bulkCulling || !tm->isCulling() || !tm->getViewRect ( windowId, &view ) ) {
+        for ( auto it = draws.begin(); it != draws.end(); it++ ) {
+            LE_TileHandle handle = it->second.handle;
+
+            for ( LE_TileDrawInfo* drawInfo : it->second.infos ) {
+                tm->draw ( handle, drawInfo->x, drawInfo->y,
+                       drawInfo->h, drawInfo->w, drawInfo->scale, drawInfo->flipv,
+                       drawInfo->fliph, drawInfo->angle, layer, z );
+            }
+        }
+        return;
+    }
+
+    if ( gridDirty || tilesChanged() ) {
+        buildGrid ();
+    }
+
+    // The grid keeps the positions it was built with
+    view.x -= gridOffset.x;
+    view.y -= gridOffset.y;
+
+    if ( ++queryCount == 0 ) {
+        std::fill ( itemQuery.begin(), itemQuery.end(), 0 );
+        queryCount = 1;
+    }
+
+    // Collect the tiles of every cell overlapping the view
+    int cx0 = (int)std::floor ( (double)view.x / cellSize );
+    int cy0 = (int)std::floor ( (double)view.y / cellSize );
+    int cx1 = (int)std::floor ( (double)( view.x + view.w - 1 ) / cellSize );
+    int cy1 = (int)std::floor ( (double)( view.y + view.h - 1 ) / cellSize );
+
+    visibleItems.clear();
+    for ( int cy = cy0; cy <= cy1; cy++ ) {
+        for ( int cx = cx0; cx <= cx1; cx++ ) {
+            auto cell = grid.find ( ( (Uint64)(Uint32)cx << 32 ) | (Uint32)cy );
+            if ( cell == grid.end() ) continue;
+
+            for ( Uint32 idx : cell->second ) {
+                if ( itemQuery[idx] == queryCount ) continue;
+                itemQuery[idx] = queryCount;
+
+                const SDL_Rect& b = gridItems[idx].bounds;
+                if ( b.x + b.w > view.x && b.x < view.x + view.w &&
+                     b.y + b.h > view.y && b.y < view.y + view.h ) {
+                    visibleItems.push_back ( idx );
+                }
+            }
+        }
+    }
+
+    // Indices follow the original draw order
+    std::sort ( visibleItems.begin(), visibleItems.end() );
+
+    for ( Uint32 idx : visibleItems ) {
+        LE_TileDrawInfo* drawInfo = gridItems[idx].info;
+        tm->draw ( gridItems[idx].handle, drawInfo->x, drawInfo->y,
+               drawInfo->h, drawInfo->w, drawInfo->scale, drawInfo->flipv,
+               drawInfo->fliph, drawInfo->angle, layer, z );
+    }
+
+    tm->addCulledDraws ( gridItems.size() - visibleItems.size() );
+}
+
+void LE_TileMap::buildGrid () {
+    LE_TextureManager* tm = LE_TEXTURE;
+
+    gridItems.clear();
+    grid.clear();
+
     for ( auto it = draws.begin(); it != draws.end(); it++ ) {
-        std::string tileId = it->first;
-        std::vector<LE_TileDrawInfo*> drawInfoV = it->second;
+        it->second.version = tm->getTileVersion ( it->second.handle );
+
+        int src_h = 0, src_w = 0;
+        tm->getTileSize ( windowId, it->first, &src_h, &src_w );
+
+        for ( LE_TileDrawInfo* drawInfo : it->second.infos ) {
+            int tile_w, tile_h;
+            if ( drawInfo->scale ) {
+                tile_w = drawInfo->w * src_w;
+                tile_h = drawInfo->h * src_h;
+            } else {
+                tile_w = drawInfo->w;
+                tile_h = drawInfo->h;
+            }
+
+            SDL_Rect bounds = { drawInfo->x, drawInfo->y, tile_w, tile_h };
+            if ( drawInfo->angle != 0 ) {
+                // Any rotation stays inside the circle around the tile center
+                double r = std::sqrt ( tile_w * tile_w + tile_h * tile_h ) / 2.0;
+                int cx = drawInfo->x + tile_w / 2;
+                int cy = drawInfo->y + tile_h / 2;
+                bounds = { (int)( cx - r ) - 1, (int)( cy - r ) - 1,
+                    (int)( 2 * r ) + 2, (int)( 2 * r ) + 2 };
+            }
 
-        for ( LE_TileDrawInfo* drawInfo : drawInfoV ) {
-            LE_TEXTURE->draw ( windowId, tileId, drawInfo->x, drawInfo->y,
-                   drawInfo->h, drawInfo->w, drawInfo->scale, drawInfo->flipv,
-                   drawInfo->fliph, drawInfo->angle );
+            gridItems.push_back ( { it->second.handle, drawInfo, bounds } );
         }
     }
+
+    mapBounds = { 0, 0, 0, 0 };
+    for ( Uint32 idx = 0; idx < gridItems.size(); idx++ ) {
+        const SDL_Rect& b = gridItems[idx].bounds;
+        if ( b.w <= 0 || b.h <= 0 ) continue;
+
+        if ( mapBounds.w == 0 ) {
+            mapBounds = b;
+        } else {
+            SDL_Rect all;
+            SDL_UnionRect ( &mapBounds, &b, &all );
+            mapBounds = all;
+        }
+
+        int cx0 = (int)std::floor ( (double)b.x / cellSize );
+        int cy0 = (int)std::floor ( (double)b.y / cellSize );
+        int cx1 = (int)std::floor ( (double)( b.x + b.w - 1 ) / cellSize );
+        int cy1 = (int)std::floor ( (double)( b.y + b.h - 1 ) / cellSize );
+
+        for ( int cy = cy0; cy <= cy1; cy++ ) {
+            for ( int cx = cx0; cx <= cx1; cx++ ) {
+                grid[( (Uint64)(Uint32)cx << 32 ) | (Uint32)cy].push_back ( idx );
+            }
+        }
+    }
+
+    itemQuery.assign ( gridItems.size(), 0 );
+    queryCount = 0;
+    gridDirty = false;
+    gridOffset = { 0, 0 };
+}
+
+bool LE_TileMap::tilesChanged () {
+    LE_TextureManager* tm = LE_TEXTURE;
+    for ( auto it = draws.begin(); it != draws.end(); it++ ) {
+        if ( tm->getTileVersion ( it->second.handle ) != it->second.version ) return true;
+    }
+    return false;
 }
 
 void LE_TileMap::blendToTexture ( std::string textureId ) {
@@ -34,14 +191,13 @@ void LE_TileMap::blendToTexture ( std::string textureId ) {
     bool first = true;
 
     for ( auto it = draws.begin(); it != draws.end(); it++ ) {
-        std::string tileId = it->first;
-        std::vector<LE_TileDrawInfo*> drawInfoV = it->second;
+        const std::string& tileId = it->first;
 
         int tile_h, tile_w, src_h, src_w;
 
         LE_TEXTURE->getTileSize ( windowId, tileId, &src_h, &src_w );
 
-        for ( LE_TileDrawInfo* drawInfo : drawInfoV ) {
+        for ( LE_TileDrawInfo* drawInfo : it->second.infos ) {
             // Get tile drawn dimentions
             if ( drawInfo->scale ) {
                 tile_h = drawInfo->h * src_h;
@@ -71,17 +227,26 @@ void LE_TileMap::blendToTexture ( std::string textureId ) {
 
     LE_TEXTURE->createTargetTexture ( windowId, textureId, h, w ); 
 
-    // Draw map in origin positions
-    moveMap ( -x_start, -y_start );
-    drawMap ();
+    // Draw the map top left corner at the texture origin
+    LE_TEXTURE->setTargetOrigin ( windowId, x_start, y_start );
+    drawTiles ();
 
-    // Restore map and render target
-    moveMap ( x_start, y_start );
     LE_TEXTURE->restoreRenderTarget ( windowId );
 }
 
 void tilemap_onRead ( const Attr& attr, const std::string value ) {
-    LE_TILEMAP->addMap ( attr.at("id"), new LE_TileMap ( stoi(attr.at("windowId")) ) );
+    LE_TileMap* newMap = new LE_TileMap ( stoi(attr.at("windowId")) );
+
+    auto layer = attr.find("layer");
+    auto z = attr.find("z");
+    newMap->setLayer ( layer != attr.end() ? stoi(layer->second) : 0,
+            z != attr.end() ? stoi(z->second) : 0 );
+
+    auto cached = attr.find("cached");
+    if ( cached != attr.end() && cached->second == "true" )
+        newMap->setCached ( "tilemap:" + attr.at("id") );
+
+    LE_TILEMAP->addMap ( attr.at("id"), newMap );
 }
 void pos_onRead ( const Attr& attr, const std::string value ) {
     LE_TILEMAP->addDrawInfo ( attr.at("id"), attr.at("tile"),
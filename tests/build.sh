@@ -1,3 +1,3 @@
 #!/bin/bash
 
-g++ -o main $1 -llambda_engine -lSDL2 -lSDL2_image -lSDL2_ttf -lSDL2_mixer
+g++ -o main $1 -llambda_engine -lSDL2 -lSDL2_image -lSDL2_ttf -lSDL2_mixer -pthread
@@ -0,0 +1,101 @@
+#include <lambda.h>
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+
+using namespace std;
+
+/*
+ * Runs a scene without a display and prints how long it took and the
+ * checksum of the last frame. Pass a checksum to compare against it:
+ *
+ *     ./main              # prints the checksum
+ *     ./main 1234567890   # exits with 1 if the frame changed
+ *     ./main --dump       # also saves the last frame to headless.png
+ *
+ * The last frame is saved as well when it doesn't match the checksum.
+ * */
+
+Uint32 mainWindow;
+
+class Bouncer : public LE_GameObject {
+    private:
+        int x_speed;
+        int y_speed;
+
+    public:
+        Bouncer ( int x_, int y_, int xs, int ys ) {
+            x = x_;
+            y = y_;
+            x_speed = xs;
+            y_speed = ys;
+        }
+
+        void setup () {
+            frames["frame"] = { "im1_tile", mainWindow };
+            currentFrame = "frame";
+            w = 50;
+            h = 50;
+            scale = false;
+        }
+
+        void update () {
+            double dt = LE_GAME->getDeltaTime();
+            x += x_speed*dt/1000;
+            y += y_speed*dt/1000;
+
+            if (x > 590 || x < 0) x_speed = -x_speed;
+            if (y > 430 || y < 0) y_speed = -y_speed;
+        }
+};
+
+class BenchScene : public LE_GameState {
+    public:
+        void on_enter () {
+            LE_TEXTURE->loadFromXmlFile ( "test.xml", mainWindow );
+            for ( int i = 0; i < 200; i++ ) {
+                addObject ( new Bouncer ( (i*37) % 590, (i*53) % 430,
+                            60 + i % 90, 40 + i % 70 ), "b" + to_string(i) );
+            }
+        }
+};
+
+int main ( int argc, char* argv[] ) {
+    bool dump = false;
+    bool compare = false;
+    Uint64 expected = 0;
+    for ( int i = 1; i < argc; i++ ) {
+        if ( strcmp ( argv[i], "--dump" ) == 0 ) {
+            dump = true;
+        } else {
+            compare = true;
+            expected = strtoull ( argv[i], nullptr, 10 );
+        }
+    }
+
+    if ( !LE_Init ( true ) ) {
+        cerr << "Could not initialize Lambda Engine" << endl;
+        return 1;
+    }
+
+    mainWindow = LE_GAME->createWindow( "headless", 640, 480 );
+
+    LE_GAME->fixFramerate ( 60 );
+    LE_FSM->push_back ( new BenchScene() );
+
+    double ms = LE_GAME->runFrames ( 600 );
+    Uint64 checksum = LE_TEXTURE->frameChecksum ( mainWindow );
+    bool mismatch = compare && checksum != expected;
+    if ( dump || mismatch ) LE_TEXTURE->dumpFrame ( mainWindow, "headless.png" );
+
+    cout << "600 frames in " << ms << " ms" << endl;
+    cout << "checksum " << checksum << endl;
+
+    LE_Quit();
+
+    if ( mismatch ) {
+        cerr << "Frame doesn't match the expected checksum, saved to headless.png" << endl;
+        return 1;
+    }
+    return 0;
+}